@@ -0,0 +1,210 @@
+#include "../include/MultipartParser.hpp"
+
+// Split-window check for MultipartParser. Each body is fed the way
+// Server::handleFileUpload() feeds it: reads of a fixed size appended to a window
+// the parser consumes from. Every read size from 1 to 199 bytes, plus the whole
+// body in one read, must produce the same parts and outcome, so no delimiter,
+// header line or CRLF can be lost or misread where a read boundary cuts it.
+//
+//   make check
+
+namespace {
+    struct Part {
+        std::string name;
+        std::string filename;
+        std::string content;
+
+        bool operator==(const Part& other) const {
+            return name == other.name && filename == other.filename && content == other.content;
+        }
+    };
+
+    enum Outcome {
+        OUTCOME_DONE,
+        OUTCOME_MALFORMED,
+        OUTCOME_TRUNCATED // The body ended before the closing delimiter
+    };
+
+    struct Result {
+        std::vector<Part> parts;
+        Outcome outcome;
+    };
+
+    struct Case {
+        const char* label;
+        std::string boundary;
+        std::string body;
+        Result expected;
+    };
+
+    const size_t MAX_READ = 199;
+
+    Result run(const Case& c, size_t readSize) {
+        MultipartParser parser(c.boundary);
+        Result result;
+        std::string window;
+        size_t windowStart = 0;
+        size_t bodyOffset = 0;
+
+        while (true) {
+            size_t consumed = 0;
+            MultipartParser::Event event = parser.parse(window.data() + windowStart, window.size() - windowStart, consumed);
+            const char* data = window.data() + windowStart;
+            windowStart += consumed;
+
+            switch (event) {
+                case MultipartParser::EVENT_NEED_MORE: {
+                    if (bodyOffset == c.body.size()) {
+                        result.outcome = OUTCOME_TRUNCATED;
+                        return result;
+                    }
+                    size_t length = std::min(readSize, c.body.size() - bodyOffset);
+                    window.erase(0, windowStart);
+                    windowStart = 0;
+                    window.append(c.body, bodyOffset, length);
+                    bodyOffset += length;
+                    break;
+                }
+                case MultipartParser::EVENT_PART_BEGIN: {
+                    Part part;
+                    part.name = parser.name();
+                    part.filename = parser.filename();
+                    result.parts.push_back(part);
+                    break;
+                }
+                case MultipartParser::EVENT_PART_DATA:
+                    result.parts.back().content.append(data, consumed);
+                    break;
+                case MultipartParser::EVENT_PART_END:
+                    break;
+                case MultipartParser::EVENT_DONE:
+                    result.outcome = OUTCOME_DONE;
+                    return result;
+                default:
+                    result.outcome = OUTCOME_MALFORMED;
+                    return result;
+            }
+        }
+    }
+
+    Part part(const std::string& name, const std::string& filename, const std::string& content) {
+        Part p;
+        p.name = name;
+        p.filename = filename;
+        p.content = content;
+        return p;
+    }
+
+    std::string formPart(const std::string& boundary, const Part& p) {
+        std::string disposition = "Content-Disposition: form-data; name=\"" + p.name + "\"";
+        if (!p.filename.empty()) {
+            disposition += "; filename=\"" + p.filename + "\"\r\nContent-Type: application/octet-stream";
+        }
+        return "--" + boundary + "\r\n" + disposition + "\r\n\r\n" + p.content + "\r\n";
+    }
+
+    Case makeCase(const char* label, const std::string& boundary, const std::string& body,
+                  const std::vector<Part>& parts, Outcome outcome) {
+        Case c;
+        c.label = label;
+        c.boundary = boundary;
+        c.body = body;
+        c.expected.parts = parts;
+        c.expected.outcome = outcome;
+        return c;
+    }
+
+    // Every byte value, plus near-misses of the delimiter and CRs that a read may end on
+    std::string awkwardContent(const std::string& boundary) {
+        std::string content;
+        for (int i = 0; i < 256; ++i) {
+            content += static_cast<char>(i);
+        }
+        content += "\r\n--" + boundary.substr(0, boundary.size() - 1) + "X\r\n";
+        content += "\r\r\n-\r\n--\r\n--" + boundary.substr(0, 5) + "\r";
+        return content;
+    }
+
+    std::vector<Case> cases() {
+        std::vector<Case> all;
+        const std::string b = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+        std::vector<Part> parts;
+
+        parts.push_back(part("title", "", "Holiday photos"));
+        parts.push_back(part("file", "photo.bin", awkwardContent(b)));
+        parts.push_back(part("empty", "empty.txt", ""));
+        std::string body;
+        for (size_t i = 0; i < parts.size(); ++i) {
+            body += formPart(b, parts[i]);
+        }
+        all.push_back(makeCase("fields, binary file and empty file", b, body + "--" + b + "--\r\n", parts, OUTCOME_DONE));
+        body = "--" + b + "--";
+        all.push_back(makeCase("closing delimiter only", b, body, std::vector<Part>(), OUTCOME_DONE));
+
+        parts.clear();
+        parts.push_back(part("note", "", "after a preamble"));
+        body = "This is the preamble.\r\nIt is ignored.\r\n" + formPart(b, parts[0]) + "--" + b + "--\r\nepilogue";
+        all.push_back(makeCase("preamble and epilogue", b, body, parts, OUTCOME_DONE));
+
+        // A "--boundary" inside the preamble without a CRLF before it is not a delimiter
+        const std::string s = "XyZ";
+        parts.clear();
+        parts.push_back(part("real", "", "value"));
+        body = "preamble --" + s + " in the middle\r\n" + formPart(s, parts[0]) + "--" + s + "--\r\n";
+        all.push_back(makeCase("delimiter-like text mid-preamble", s, "\r\n" + body, parts, OUTCOME_DONE));
+
+        parts.clear();
+        parts.push_back(part("padded", "", "x"));
+        body = "--" + s + " \t \r\nContent-Disposition: form-data; name=\"padded\"\n\nx\r\n--" + s + "--";
+        all.push_back(makeCase("transport padding and LF-only header lines", s, body, parts, OUTCOME_DONE));
+
+        parts.clear();
+        parts.push_back(part("cut", "cut.bin", "unfinished"));
+        body = "--" + s + "\r\nContent-Disposition: form-data; name=\"cut\"; filename=\"cut.bin\"\r\n\r\nunfinished";
+        all.push_back(makeCase("body without a closing delimiter", s, body, parts, OUTCOME_TRUNCATED));
+
+        parts.clear();
+        body = "--" + s + "junk\r\n";
+        all.push_back(makeCase("text straight after a delimiter", s, body, parts, OUTCOME_MALFORMED));
+        return all;
+    }
+
+    const char* outcomeName(Outcome outcome) {
+        switch (outcome) {
+            case OUTCOME_DONE: return "done";
+            case OUTCOME_MALFORMED: return "malformed";
+            default: return "truncated";
+        }
+    }
+}
+
+int main() {
+    std::vector<Case> all = cases();
+    int failures = 0;
+
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Case& c = all[i];
+        size_t failedAt = 0;
+        Result result;
+        for (size_t readSize = 1; readSize <= MAX_READ + 1 && !failedAt; ++readSize) {
+            size_t size = (readSize > MAX_READ) ? c.body.size() : readSize;
+            result = run(c, size);
+            if (result.outcome != c.expected.outcome || result.parts != c.expected.parts) {
+                failedAt = size;
+            }
+        }
+
+        if (failedAt) {
+            ++failures;
+            std::cout << "FAIL " << c.label << ": with " << failedAt << "-byte reads got "
+                      << result.parts.size() << " parts, " << outcomeName(result.outcome) << "; expected "
+                      << c.expected.parts.size() << " parts, " << outcomeName(c.expected.outcome) << std::endl;
+        } else {
+            std::cout << "ok   " << c.label << " (" << c.body.size() << " bytes)" << std::endl;
+        }
+    }
+
+    std::cout << all.size() - failures << "/" << all.size() << " bodies parse the same with reads of 1 to "
+              << MAX_READ << " bytes and in one piece" << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#ifndef ATOMICFILE_HPP
+#define ATOMICFILE_HPP
+
+#include "webserv.hpp"
+
+// A file written out of sight next to its destination and then moved into place
+// in one step, so a reader of the destination sees either the previous file or
+// the complete new one, never a partial write. The staging file is unnamed
+// (O_TMPFILE) where the filesystem allows it, else a hidden name in the same
+// directory; commit() names it. Dropped without a commit, it leaves no trace.
+class AtomicFile {
+	public:
+		AtomicFile();
+		~AtomicFile(); // Discards an uncommitted file
+
+		// Starts a new file for `destPath`, discarding any uncommitted one
+		bool open(const std::string& destPath);
+		bool write(const char* data, size_t length);
+		// Appends `length` bytes of `sourceFd` from offset 0: copy_file_range() where the
+		// kernel can copy (or reflink) them itself, read/write otherwise
+		bool copyFrom(int sourceFd, size_t length);
+		bool commit();
+		void discard();
+
+		// Gives the unnamed (O_TMPFILE) file behind `fd` the name `destPath`, replacing
+		// whatever is there. Fails with EXDEV when it lives on another filesystem.
+		static bool linkInto(int fd, const std::string& destPath);
+
+	private:
+		std::string _destPath;
+		std::string _tempPath; // Hidden staging name; empty for an O_TMPFILE
+		int _fd;
+
+		AtomicFile(const AtomicFile&);
+		AtomicFile& operator=(const AtomicFile&);
+};
+
+#endif
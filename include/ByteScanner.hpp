@@ -0,0 +1,29 @@
+#ifndef BYTESCANNER_HPP
+#define BYTESCANNER_HPP
+
+#include "webserv.hpp"
+
+// Delimiter and token scanning for the request parser, 16 bytes per step with
+// SSE2 on x86 and a scalar fallback everywhere else. The kernel is picked once
+// at startup.
+class ByteScanner {
+	public:
+		enum Level {
+			LEVEL_SCALAR,
+			LEVEL_SSE2
+		};
+
+		// Offset of the first '\n' in data[0, length), or length if there is none
+		static size_t findLineEnd(const char* data, size_t length);
+		// Offset of the first byte that is not an RFC 9110 tchar, or length
+		static size_t skipToken(const char* data, size_t length);
+		// The same scans with a given kernel, which must not exceed detectLevel()
+		static size_t findLineEnd(const char* data, size_t length, Level level);
+		static size_t skipToken(const char* data, size_t length, Level level);
+
+		static Level level();
+		static Level detectLevel();
+		static const char* levelName(Level level);
+};
+
+#endif
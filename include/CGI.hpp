@@ -13,7 +13,7 @@ class CGI {
 		void setScriptPath(const std::string& path);
 		void setInterpreter(const std::string& interpreter);
 		void setBody(const std::string& body);
-		void setBodyFromFile(const std::string& filePath); // For memory-efficient large body handling
+		void setBodyLength(size_t length); // Body is streamed separately; records its length
 		void setEnvironmentVariable(const std::string& key, const std::string& value);
 		
 		// Environment setup
@@ -31,6 +31,7 @@ class CGI {
 		std::string _interpreter;
 		std::map<std::string, std::string> _envVars;
 		std::string _body;
+		size_t _bodyLength;
 		
 		void setupCommonEnvVars();
 		std::string extractFilename(const std::string& path) const;
@@ -2,7 +2,12 @@
 #define CLIENT_HPP
 
 #include "webserv.hpp"
-#include <fstream>
+#include "Config.hpp"
+#include "TimerWheel.hpp"
+#include "OutputQueue.hpp"
+#include "RequestParser.hpp"
+#include "HeaderTable.hpp"
+#include "HttpRequest.hpp"
 
 class Client {
 	public:
@@ -24,7 +29,8 @@ class Client {
 		// Data handling
 		bool readData();
 		bool isRequestComplete() const;
-		void clearRequest();
+		void clearRequest(); // Keeps any pipelined bytes that followed the request
+		bool parseBufferedRequest();
 		
 		// Reading control
 		void stopReading();
@@ -35,12 +41,29 @@ class Client {
 		int getFd() const;
 		size_t getContentLength() const;
 		bool isChunked() const;
-		const std::string& getRequest() const;
-		const std::string& getBodyFilePath() const;
+		HttpRequest& getRequest();
+		// Location matched for the request, resolved once by the server at header time
+		bool hasLocation() const;
+		const LocationConfig& getLocation() const;
+		void setLocation(const LocationConfig& location);
+		bool hasBodyFailed() const; // The body could not be buffered or spooled
+		bool expectsContinue() const; // Sent "Expect: 100-continue"
 		const std::string& getBuffer() const;
-		time_t getLastActivity() const;
-		void updateActivity();
-		void beginReadingBody(size_t maxBodySize);
+		const std::string& getPeerAddress(); // Formatted on first use
+		void setPeerAddress(const struct sockaddr_in& addr);
+		const ServerConfig* getServerConfig() const;
+		void setServerConfig(const ServerConfig* serverConfig);
+		TimerWheel::TimerId getTimer() const;
+		void setTimer(TimerWheel::TimerId timer);
+		bool isHeaderTimerArmed() const;
+		void setHeaderTimerArmed(bool armed);
+		OutputQueue& getOutput();
+		const OutputQueue& getOutput() const;
+		bool isAwaitingResponse() const;
+		void setAwaitingResponse(bool awaiting);
+		// Bodies up to memoryLimit bytes stay in memory; larger ones are spooled to disk,
+		// in spoolDirectory if it is given and usable
+		void beginReadingBody(size_t maxBodySize, size_t memoryLimit, const std::string& spoolDirectory);
 		void markForCloseAfterWrite();
 		bool shouldCloseAfterWrite() const;
 		bool parseRequest();
@@ -48,22 +71,32 @@ class Client {
 	private:
 		int _fd;
 		std::string _buffer;
-		time_t _lastActivity;
+		struct sockaddr_in _peerAddr;
+		std::string _peerAddress;
+		const ServerConfig* _serverConfig; // Config of the listener it arrived on
+		TimerWheel::TimerId _timer;
+		bool _headerTimerArmed;
+		bool _awaitingResponse; // An async (CGI) response is outstanding; hold later requests
+		OutputQueue _output;
 		bool _stopReading;
 
 		ClientState _state;
-		std::string _headers;
-		std::string _bodyFilePath;
-		std::ofstream* _bodyFile;
+		RequestParser _parser; // Slices into _buffer until the headers are complete
+		HttpRequest _request;
+		LocationConfig _location;
+		bool _locationResolved;
 		size_t _contentLength;
 		size_t _maxBodySize;
 		size_t _bodyBytesReceived;
 		size_t _currentChunkSize;
 		bool _isChunked;
+		bool _bodyFailed;
+		bool _spliceBody; // Body bytes go from the socket into the spool file by splice()
+		bool _expectContinue;
 		bool _requestComplete;
 		bool _closeConnectionAfterWrite;
-		std::string createTempFile();
-		bool openBodyFile();
+		bool failBody();
+		bool spliceBody();
 		bool parseHeadersFromBuffer();
 		bool handleBodyRead();
 		bool handleChunkRead();
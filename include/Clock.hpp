@@ -0,0 +1,21 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include "webserv.hpp"
+
+// Wall-clock time as an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), used for
+// the Date header and log timestamps. Each thread keeps its own formatted date,
+// refreshed by update() once per event loop iteration, so building a response
+// makes no time() call and formats nothing; gmtime_r()/strftime() run at most
+// once per second per thread.
+class Clock {
+	public:
+		static void update();
+		// The date as of this thread's last update(); valid until its next one
+		static const std::string& httpDate();
+
+	private:
+		Clock();
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef COMPRESSOR_HPP
+#define COMPRESSOR_HPP
+
+#include "webserv.hpp"
+#include <zlib.h>
+
+// Incremental zlib deflate producing either a gzip or a zlib ("deflate" content
+// coding) stream. Input can be fed in pieces as it arrives; compressed bytes are
+// appended to the caller's buffer, so only the compressed form is ever held.
+class Compressor {
+	public:
+		enum Format {
+			FORMAT_GZIP,
+			FORMAT_DEFLATE
+		};
+
+		Compressor();
+		~Compressor();
+
+		bool begin(Format format, int level); // level 1 (fast) .. 9 (small)
+		bool update(const char* data, size_t length, std::string& out);
+		bool finish(std::string& out); // Flushes the trailer; the stream can then begin() again
+		void reset();
+
+		static const char* encodingName(Format format);
+		static bool compress(Format format, int level, const std::string& in, std::string& out);
+
+	private:
+		z_stream _stream;
+		bool _active;
+
+		Compressor(const Compressor& other);
+		Compressor& operator=(const Compressor& other);
+
+		bool run(int flush, std::string& out);
+};
+
+#endif
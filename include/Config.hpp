@@ -11,6 +11,7 @@ struct ServerConfig {
     std::string index;
     std::map<int, std::string> errorPages;
     size_t maxBodySize;
+    size_t clientBodyBufferSize; // Request bodies up to this size are kept in memory
     std::vector<LocationConfig> locations;
     std::vector<std::string> allowedMethods;
     bool autoIndex;
@@ -18,7 +19,27 @@ struct ServerConfig {
     std::string cgiPath;
     std::map<std::string, std::string> cgiExtensions;
 	int keepAliveTimeout;
+    int clientHeaderTimeout; // Seconds a client may take to send a request's headers
     int cgiTimeout;
+    bool gzipStatic;   // Serve foo.gz in place of foo to clients accepting gzip
+    bool brotliStatic; // Likewise foo.br for br
+};
+
+// Directives that live outside any server block and apply to the whole process
+struct GlobalConfig {
+    std::string eventEngine;
+    int workerThreads;
+    int workerProcesses;       // 0 = no master process, serve from the main process
+    size_t workerMemoryLimit;  // Resident size after which a worker is recycled (0 = off)
+    int acceptBatch;           // Max connections accepted per listener wakeup
+    int shutdownTimeout;       // Seconds a stopping event loop lets in-flight requests finish
+    size_t fileCacheSize;      // Bytes of static file content cached per event loop (0 = off)
+    size_t fileCacheMaxFile;   // Larger files are always served from disk
+    int fileCacheValid;        // Seconds before an unwatched entry is re-stat()ed
+    std::vector<std::string> fileCachePrewarm; // URIs loaded into the cache at startup
+    size_t openFileCache;      // Max cached path lookups / open descriptors per event loop (0 = off)
+    int openFileCacheValid;    // Seconds a cached lookup is trusted before it is re-stat()ed
+    bool openFileCacheErrors;  // Also cache failed lookups (404s)
 };
 
 class Config {
@@ -32,11 +53,14 @@ class Config {
 		bool parseFile(const std::string& filename);
 		bool parseServerBlock(const std::string& block);
 		bool parseLocationBlock(const std::string& block, LocationConfig& location);
+		void parseGlobalDirectives(const std::string& content);
+		void setGlobalDefaults(GlobalConfig& global);
 		void setDefaults(ServerConfig& server);
 		void setLocationDefaults(LocationConfig& location) const;
 		
 		// Getters
 		const std::vector<ServerConfig>& getServers() const;
+		const GlobalConfig& getGlobalConfig() const;
 		ServerConfig getDefaultServer() const;
 		ServerConfig getServerByPort(int port) const;
 		ServerConfig getServerByName(const std::string& serverName) const;
@@ -57,9 +81,11 @@ class Config {
 		static std::string trim(const std::string& str);
 		static std::string extractValue(const std::string& line);
 		static std::vector<std::string> extractValues(const std::string& line);
+		static size_t parseSize(const std::string& value);
 	
 	private:
 		std::vector<ServerConfig> _servers;
+		GlobalConfig _global;
 		std::string _configFile;
 };
 
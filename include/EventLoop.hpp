@@ -0,0 +1,89 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "webserv.hpp"
+
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
+
+class EventLoop {
+	public:
+		// Readiness backends, in order of preference
+		enum Engine {
+			ENGINE_EPOLL,
+			ENGINE_POLL
+		};
+
+		// What kind of object a registered fd belongs to
+		enum HandlerType {
+			HANDLER_NONE,
+			HANDLER_LISTENER,
+			HANDLER_CLIENT,
+			HANDLER_CGI_OUTPUT,
+			HANDLER_CGI_INPUT,
+			HANDLER_WAKEUP,
+			HANDLER_FILE_WATCH
+		};
+
+		// Interest / readiness flags (independent of the backend)
+		enum {
+			EVENT_READ = 1,
+			EVENT_WRITE = 2,
+			EVENT_ERROR = 4
+		};
+
+		struct Event {
+			int fd;
+			HandlerType type;
+			int events;
+			unsigned int generation;
+		};
+
+		EventLoop();
+		~EventLoop();
+
+		// Setup
+		bool open(Engine engine);
+		void close();
+		Engine getEngine() const;
+		static const char* engineName(Engine engine);
+		static bool parseEngine(const std::string& name, Engine& engine);
+
+		// Registration (all O(1))
+		bool add(int fd, HandlerType type, int events);
+		bool modify(int fd, int events);
+		void remove(int fd);
+		HandlerType getType(int fd) const;
+
+		// Waiting
+		int wait(std::vector<Event>& ready, int timeoutMs);
+		bool isCurrent(const Event& event) const;
+
+	private:
+		struct Entry {
+			HandlerType type;
+			int events;
+			size_t pollIndex;
+			unsigned int generation;
+
+			Entry() : type(HANDLER_NONE), events(0), pollIndex(0), generation(0) {}
+		};
+
+		Engine _engine;
+		std::vector<Entry> _entries; // Indexed by fd
+		std::vector<struct pollfd> _pollFds;
+		int _epollFd;
+#ifdef __linux__
+		std::vector<struct epoll_event> _epollEvents;
+#endif
+
+		int waitPoll(std::vector<Event>& ready, int timeoutMs);
+		int waitEpoll(std::vector<Event>& ready, int timeoutMs);
+		Entry* lookup(int fd);
+
+		EventLoop(const EventLoop&);
+		EventLoop& operator=(const EventLoop&);
+};
+
+#endif
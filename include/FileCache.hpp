@@ -0,0 +1,75 @@
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include "webserv.hpp"
+#include "FileHandle.hpp"
+#include "SharedBuffer.hpp"
+#include <list>
+#include <stdint.h>
+
+// Per-event-loop LRU cache of small static files, keyed by resolved request path.
+// A hit costs no syscalls at all. Entries are dropped when inotify reports a change
+// to their source file; where no watch could be set up they are re-stat()ed once
+// the validity interval has passed. Not shared across threads.
+class FileCache {
+	public:
+		struct Entry {
+			std::string source;   // File the content was read from (differs for directory indexes)
+			SharedBuffer content; // Queued on connections as is, never copied per hit
+			std::string mimeType;
+			std::string etag;
+			std::string lastModified; // mtime preformatted as an HTTP date
+			time_t mtime;
+			ino_t inode;
+			dev_t device;
+			uint64_t validatedAt; // Loop clock (ms) of the last check against the file
+			bool watched;         // Covered by an inotify watch on its directory (never for symlinks)
+			std::list<std::string>::iterator lru;
+		};
+
+		FileCache();
+		~FileCache();
+
+		// maxBytes of 0 disables the cache; files above maxFileSize are never cached
+		void configure(size_t maxBytes, size_t maxFileSize, int validSeconds);
+		bool isEnabled() const;
+		bool openWatcher();   // inotify; without it entries fall back to revalidation
+		void close();
+		int watchFd() const;  // -1 when inotify is not in use
+
+		// Fresh entry for `key`, or NULL; a hit becomes the most recently used entry
+		const Entry* lookup(const std::string& key, uint64_t now);
+		// Copies the content of an open file into the cache under `key`
+		const Entry* insert(const std::string& key, const FileHandle& file, const std::string& mimeType,
+							const std::string& etag, uint64_t now);
+		// Drops every entry stored under `path` or read from it
+		void invalidate(const std::string& path);
+		// Drains the inotify fd, appending the paths reported as changed to `changed`
+		void processWatchEvents(std::vector<std::string>& changed);
+
+		size_t bytes() const;
+		unsigned long hits() const;
+		unsigned long misses() const;
+
+	private:
+		std::map<std::string, Entry> _entries;
+		std::list<std::string> _lru; // Front is the most recently used key
+		std::map<int, std::string> _watchDirs; // inotify watch descriptor -> directory
+		std::map<std::string, int> _dirWatches;
+		size_t _bytes;
+		size_t _maxBytes;
+		size_t _maxFileSize;
+		uint64_t _validMs;
+		int _watchFd;
+		unsigned long _hits;
+		unsigned long _misses;
+
+		FileCache(const FileCache& other);
+		FileCache& operator=(const FileCache& other);
+
+		bool watchDirectory(const std::string& dir);
+		void erase(std::map<std::string, Entry>::iterator it);
+		void evict(size_t needed);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FILEHANDLE_HPP
+#define FILEHANDLE_HPP
+
+#include "webserv.hpp"
+
+// Reference-counted read-only file descriptor. Copies share the descriptor, which
+// is closed when the last copy goes away, so a file can be handed from a response
+// to the output queue without being reopened. Not shared across threads.
+class FileHandle {
+	public:
+		FileHandle();
+		FileHandle(const FileHandle& other);
+		FileHandle& operator=(const FileHandle& other);
+		~FileHandle();
+
+		// Opens `path` (O_RDONLY | O_CLOEXEC) and records its size; false with errno set
+		bool open(const std::string& path);
+		void reset();
+
+		bool isOpen() const;
+		int fd() const;
+		size_t size() const;
+		time_t mtime() const;
+		ino_t inode() const;
+		dev_t device() const;
+		const std::string& path() const; // As passed to open()
+
+	private:
+		struct Shared {
+			int fd;
+			size_t size;
+			time_t mtime;
+			ino_t inode;
+			dev_t device;
+			std::string path;
+			int refs;
+		};
+
+		Shared* _shared;
+
+		void release();
+};
+
+#endif
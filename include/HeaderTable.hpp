@@ -0,0 +1,89 @@
+#ifndef HEADERTABLE_HPP
+#define HEADERTABLE_HPP
+
+#include "webserv.hpp"
+
+// Ordered, case-insensitive header fields for requests and responses. The first
+// INLINE_CAPACITY fields live inside the table itself, so a typical message needs
+// no per-field node allocations; well-known names are interned as an index into a
+// static table instead of being copied, and compare as integers. Fields serialize
+// in insertion order with one exact-size append.
+class HeaderTable {
+	public:
+		enum Name {
+			HEADER_SERVER,
+			HEADER_DATE,
+			HEADER_CONTENT_TYPE,
+			HEADER_CONTENT_LENGTH,
+			HEADER_CONNECTION,
+			HEADER_LOCATION,
+			HEADER_ETAG,
+			HEADER_LAST_MODIFIED,
+			HEADER_ACCEPT_RANGES,
+			HEADER_CONTENT_RANGE,
+			HEADER_CONTENT_ENCODING,
+			HEADER_VARY,
+			HEADER_TRANSFER_ENCODING,
+			HEADER_HOST,
+			HEADER_USER_AGENT,
+			HEADER_ACCEPT,
+			HEADER_ACCEPT_ENCODING,
+			HEADER_RANGE,
+			HEADER_IF_RANGE,
+			HEADER_IF_NONE_MATCH,
+			HEADER_IF_MODIFIED_SINCE,
+			HEADER_EXPECT,
+			HEADER_COOKIE,
+			HEADER_SET_COOKIE,
+			HEADER_CACHE_CONTROL,
+			HEADER_ALLOW,
+			HEADER_KEEP_ALIVE,
+			HEADER_UNKNOWN // Not interned; the name is stored with the field
+		};
+
+		HeaderTable();
+
+		// Replaces the value of an existing field with the same name, else appends one
+		void set(const std::string& name, const std::string& value);
+		void set(Name name, const std::string& value);
+		void setNumber(Name name, size_t value); // Formats in place, reusing the old value's storage
+		const std::string* find(const std::string& name) const; // NULL when absent
+		const std::string* find(Name name) const;
+		void remove(const std::string& name);
+		void remove(Name name);
+		void clear();
+
+		size_t size() const;
+		std::string nameAt(size_t index) const; // Canonical spelling for interned names
+		const std::string& valueAt(size_t index) const;
+
+		// Appends "Name: value\r\n" for every field
+		void serialize(std::string& out) const;
+		size_t serializedLength() const;
+
+		static Name intern(const char* name, size_t length); // HEADER_UNKNOWN if not well-known
+		static const char* canonicalName(Name name);
+
+	private:
+		struct Field {
+			Name known;
+			std::string name; // Only set for HEADER_UNKNOWN
+			std::string value;
+		};
+
+		enum {
+			INLINE_CAPACITY = 16
+		};
+
+		Field _inline[INLINE_CAPACITY];
+		std::vector<Field> _overflow;
+		size_t _count;
+
+		Field& field(size_t index);
+		const Field& field(size_t index) const;
+		size_t indexOf(Name known, const std::string& name) const; // _count when absent
+		Field& append(Name known);
+		void erase(size_t index);
+};
+
+#endif
@@ -2,42 +2,55 @@
 #define HTTPREQUEST_HPP
 
 #include "webserv.hpp"
+#include "HeaderTable.hpp"
+#include "RequestParser.hpp"
+#include "RequestBody.hpp"
 
 class HttpRequest {
 	public:
 		HttpRequest();
-		HttpRequest(const std::string& headers, const std::string& bodyFilePath);
+		explicit HttpRequest(const std::string& headers);
 		~HttpRequest();
 
 		// Parsing
-		bool parse(const std::string& headers, const std::string& bodyFilePath);
-		void parseRequestLine(const std::string& line);
-		void parseHeaders(const std::vector<std::string>& headerLines);
+		bool parse(const std::string& headers);
+		// Materializes a request `parser` has already scanned in `data`
+		bool parse(const char* data, const RequestParser& parser);
 		void parseQueryString(const std::string& uri);
 		
 		// Getters
 		const std::string& getMethod() const;
 		const std::string& getUri() const;
 		const std::string& getVersion() const;
-		const std::string& getBodyFilePath() const;
-		const std::map<std::string, std::string>& getHeaders() const;
-		const std::map<std::string, std::string>& getQueryParams() const;
-		std::string getHeader(const std::string& key) const;
+		const RequestBody& getBody() const;
+		RequestBody& getBody(); // Filled by the client as the body arrives
+		const HeaderTable& getHeaders() const; // Built from the slices on first use
+		const std::string& getQueryString() const; // Raw, without the '?'
+		const std::map<std::string, std::string>& getQueryParams() const; // Decoded on first use
+		std::string getHeader(const std::string& key) const; // Copies only the one value
 		bool isValid() const;
 		
 		// Utilities
 		std::string getPath() const;
 		bool hasHeader(const std::string& key) const;
 		size_t getContentLength() const;
+		bool acceptsEncoding(const std::string& coding) const; // Per Accept-Encoding, honoring q=0
 
 	private:
 		std::string _method;
 		std::string _uri;
 		std::string _version;
-		std::map<std::string, std::string> _headers;
-		std::string _bodyFilePath;
-		std::map<std::string, std::string> _queryParams;
+		std::string _headerBlock; // The request's own copy of its header bytes
+		std::vector<RequestParser::Field> _fields; // Slices into _headerBlock
+		mutable HeaderTable _headers;
+		mutable bool _headersMaterialized;
+		RequestBody _body;
+		std::string _queryString;
+		mutable std::map<std::string, std::string> _queryParams;
+		mutable bool _queryParamsParsed;
 		bool _isValid;
+
+		const RequestParser::Field* findField(const std::string& key) const; // Last match, NULL when absent
 };
 
 #endif
\ No newline at end of file
@@ -2,9 +2,25 @@
 #define HTTPRESPONSE_HPP
 
 #include "webserv.hpp"
+#include "FileHandle.hpp"
+#include "SharedBuffer.hpp"
+#include "HeaderTable.hpp"
 
 class HttpResponse {
 	public:
+		// A slice of the body file, preceded by `header` (a multipart/byteranges part header)
+		struct FilePart {
+			std::string header;
+			off_t offset;
+			size_t length;
+		};
+
+		enum RangeResult {
+			RANGE_IGNORED,      // No usable Range header: send the whole file
+			RANGE_APPLIED,      // Response turned into a 206
+			RANGE_UNSATISFIABLE // None of the ranges overlap the file: answer 416
+		};
+
 		HttpResponse();
 		HttpResponse(int statusCode);
 		~HttpResponse();
@@ -20,19 +36,51 @@ class HttpResponse {
 		void setContentType(const std::string& type);
 		void setContentLength(size_t length);
 		std::string getHeader(const std::string& key) const;
+		void removeHeader(const std::string& key);
 		
 		// Body
 		void setBody(const std::string& body);
 		void appendBody(const std::string& data);
 		const std::string& getBody() const;
+		void takeBody(std::string& out); // Moves the body out by swap, leaving it empty
+		void dropBody(); // For HEAD: no body, but Content-Length still describes it
+		void adoptBody(std::string& body); // Takes over the contents of `body` by swap
+		// Generated bodies (CGI, listings, JSON) may pass through the compression stage
+		void setCompressible(bool compressible);
+		bool isCompressible() const;
+		// Serves `length` bytes of `file` from `offset` as the body, sent with sendfile()
+		void setBodyFile(const FileHandle& file, off_t offset, size_t length);
+		bool hasBodyFile() const;
+		const FileHandle& getBodyFile() const;
+		// File slices go out in order, followed by any string body (the closing boundary)
+		const std::vector<FilePart>& getBodyFileParts() const;
+		// Serves bytes shared with the file cache as the body, queued without a copy
+		void setSharedBody(const SharedBuffer& body);
+		bool hasSharedBody() const;
+		const SharedBuffer& getSharedBody() const;
+		// Narrows a full file response to the byte ranges of a Range header (RFC 9110 14.2),
+		// unless `ifRange` (NULL when absent) no longer matches the ETag or Last-Modified
+		RangeResult applyRange(const std::string& range, const std::string* ifRange);
+		
+		// Conditional GET (RFC 9110 13.1.2, 13.1.3): true when the client's copy, per
+		// If-None-Match or else If-Modified-Since, still matches this response
+		bool isNotModified(const std::string& ifNoneMatch, const std::string& ifModifiedSince) const;
+		void setNotModified(); // Turns the response into a bodiless 304 keeping its validators
 		
 		// Generation
 		std::string toString() const;
+		std::string serializeHeaders() const; // Status line and headers, up to the blank line
+		void serializeHeaders(std::string& out) const; // Appends them to `out` in one sized pass
 		void clear();
 		
 		// Common responses
 		static HttpResponse createErrorResponse(int statusCode);
 		static HttpResponse createFileResponse(const std::string& filePath);
+		static HttpResponse createFileResponse(const FileHandle& file);
+		
+		// Validators: strong from a file's inode, size and mtime; weak from generated content
+		static std::string makeETag(const FileHandle& file);
+		static std::string makeWeakETag(const std::string& content);
 		
 		// Utilities
 		static std::string getStatusMessage(int code);
@@ -40,9 +88,15 @@ class HttpResponse {
 	private:
 		int _statusCode;
 		std::string _statusMessage;
-		std::map<std::string, std::string> _headers;
+		HeaderTable _headers;
 		std::string _body;
+		FileHandle _bodyFile;
+		std::vector<FilePart> _bodyFileParts;
+		SharedBuffer _sharedBody;
+		bool _compressible;
 		std::string _version;
+
+		static bool parseRanges(const std::string& range, size_t fileSize, std::vector<std::pair<size_t, size_t> >& ranges);
 };
 
 #endif
\ No newline at end of file
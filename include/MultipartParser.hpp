@@ -0,0 +1,63 @@
+#ifndef MULTIPARTPARSER_HPP
+#define MULTIPARTPARSER_HPP
+
+#include "webserv.hpp"
+
+// Incremental multipart/form-data parser (RFC 7578). The body is fed through a
+// window of any size: parse() reports one event per call and how many bytes of
+// the window it has used up, and the caller drops those bytes before the next
+// call. Bytes that may be the start of a delimiter split across two reads are
+// left unconsumed until more data arrives, so part content is passed on exactly
+// once and nothing bigger than a part header line is ever held.
+class MultipartParser {
+	public:
+		enum Event {
+			EVENT_NEED_MORE,   // Append more of the body to the window
+			EVENT_PART_BEGIN,  // Part headers are in: name(), filename()
+			EVENT_PART_DATA,   // The first `consumed` bytes of the window are part content
+			EVENT_PART_END,
+			EVENT_DONE,        // Closing delimiter seen; the epilogue is ignored
+			EVENT_MALFORMED
+		};
+
+		// `boundary` as given in the Content-Type parameter, without the leading "--"
+		explicit MultipartParser(const std::string& boundary);
+
+		Event parse(const char* data, size_t length, size_t& consumed);
+
+		const std::string& name() const;     // Form field name of the current part
+		const std::string& filename() const; // Empty for plain form fields
+
+		// The boundary parameter of a multipart Content-Type, unquoted; empty if absent
+		static std::string boundaryFrom(const std::string& contentType);
+
+	private:
+		enum State {
+			STATE_PREAMBLE,
+			STATE_AFTER_DELIMITER,
+			STATE_HEADERS,
+			STATE_BODY,
+			STATE_DONE,
+			STATE_MALFORMED
+		};
+
+		enum {
+			MAX_HEADER_BYTES = 16 * 1024, // Per part; a line that long without LF is malformed
+			MAX_PADDING = 256             // Transport padding after a delimiter
+		};
+
+		State _state;
+		std::string _delimiter; // CRLF "--" boundary
+		size_t _skip[256];      // Boyer-Moore-Horspool shifts for _delimiter
+		bool _atBodyStart;      // No byte of the body has been consumed or ruled out yet
+		size_t _headerBytes;
+		std::string _name;
+		std::string _filename;
+
+		Event fail();
+		size_t findDelimiter(const char* data, size_t length) const;
+		size_t heldBack(const char* data, size_t length) const;
+		void parseHeaderLine(const char* line, size_t length);
+};
+
+#endif
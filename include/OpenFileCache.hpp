@@ -0,0 +1,62 @@
+#ifndef OPENFILECACHE_HPP
+#define OPENFILECACHE_HPP
+
+#include "webserv.hpp"
+#include "FileHandle.hpp"
+#include <list>
+#include <stdint.h>
+
+// Per-event-loop cache of path lookups: open descriptors plus their fstat() data
+// for regular files, and the outcome for directories and failed lookups. Within
+// the validity window a hit costs no syscalls; afterwards a single stat() decides
+// whether the cached descriptor still names the file at that path.
+class OpenFileCache {
+	public:
+		enum Kind {
+			KIND_FILE,
+			KIND_DIRECTORY,
+			KIND_MISSING, // ENOENT / ENOTDIR
+			KIND_ERROR    // Any other failure, e.g. EACCES
+		};
+
+		struct Lookup {
+			Kind kind;
+			int error;       // errno for KIND_ERROR
+			FileHandle file; // Open for KIND_FILE
+		};
+
+		OpenFileCache();
+
+		// maxEntries of 0 disables caching; lookups then always go to the filesystem
+		void configure(size_t maxEntries, int validSeconds, bool cacheErrors);
+		Lookup lookup(const std::string& path, uint64_t now);
+		void invalidate(const std::string& path);
+		void clear();
+
+		unsigned long hits() const;
+		unsigned long misses() const;
+
+	private:
+		struct Entry {
+			Lookup result;
+			uint64_t validatedAt; // Loop clock (ms) of the last check against the path
+			std::list<std::string>::iterator lru;
+		};
+
+		std::map<std::string, Entry> _entries;
+		std::list<std::string> _lru; // Front is the most recently used path
+		size_t _maxEntries;
+		uint64_t _validMs;
+		bool _cacheErrors;
+		unsigned long _hits;
+		unsigned long _misses;
+
+		OpenFileCache(const OpenFileCache& other);
+		OpenFileCache& operator=(const OpenFileCache& other);
+
+		static Lookup resolve(const std::string& path);
+		static bool stillCurrent(const std::string& path, const Lookup& result);
+		void erase(std::map<std::string, Entry>::iterator it);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef OUTPUTQUEUE_HPP
+#define OUTPUTQUEUE_HPP
+
+#include "webserv.hpp"
+#include "FileHandle.hpp"
+#include "SharedBuffer.hpp"
+#include <deque>
+#include <sys/uio.h>
+
+// Per-connection queue of outgoing segments: serialized header blocks, body
+// slices (taken over by swap, never copied), shared cache buffers and file ranges. flush() gathers
+// consecutive memory segments into one sendmsg() (corked with MSG_MORE when a file
+// follows), sends file ranges with sendfile(), and remembers how far into the front
+// segment a partial write got, so memory per transfer stays constant.
+class OutputQueue {
+	public:
+		OutputQueue();
+
+		void append(const std::string& data);
+		void appendSwap(std::string& data);  // Steals the contents of `data`
+		void appendShared(const SharedBuffer& buffer); // Holds a reference, no copy
+		void appendFile(const FileHandle& file, off_t offset, size_t length);
+
+		bool empty() const;
+		size_t size() const; // Bytes still to be written
+		// The part of size() this connection holds in memory; file ranges and shared
+		// buffers cost it only a reference
+		size_t memorySize() const;
+
+		// Writes as much as the socket takes, up to FLUSH_BUDGET bytes so one fast
+		// download cannot monopolize the loop. Returns the number of bytes written
+		// (0 if it would block) or -1 on a socket or file error.
+		ssize_t flush(int socketFd);
+		void clear();
+
+	private:
+		struct Segment {
+			std::string data;
+			SharedBuffer shared; // Sent instead of `data` when set
+			FileHandle file;     // Closed for memory segments
+			off_t offset;    // File segments: next byte to send
+			size_t length;
+		};
+
+		enum {
+			MAX_IOV = 64,
+			FILE_CHUNK = 1 << 20,
+			FLUSH_BUDGET = 4 << 20
+		};
+
+		std::deque<Segment> _segments;
+		size_t _frontOffset; // Bytes of the front memory segment already written
+		size_t _bytes;
+		size_t _memoryBytes;
+
+		ssize_t flushMemory(int socketFd, size_t& requested);
+		ssize_t flushFile(int socketFd, size_t& requested);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef REQUESTBODY_HPP
+#define REQUESTBODY_HPP
+
+#include "webserv.hpp"
+
+// A request body as it is received: held in a pooled memory buffer up to a size
+// threshold, and spilled to an anonymous spool file once it grows past it. Every
+// consumer reads through this class, so none of them cares where the bytes are.
+// The spool never has a name in /tmp (O_TMPFILE, else memfd), so nothing is left
+// behind by a crash. Reference-counted like FileHandle: copies share the storage,
+// and the spool is closed when the last copy goes away. Not shared across threads.
+class RequestBody {
+	public:
+		RequestBody();
+		RequestBody(const RequestBody& other);
+		RequestBody& operator=(const RequestBody& other);
+		~RequestBody();
+
+		// Starts an empty body kept in memory until it exceeds `memoryLimit` bytes. The
+		// spool goes in `spoolDirectory` when possible (so it can be linked into place
+		// there rather than copied), /tmp otherwise.
+		void begin(size_t memoryLimit, const std::string& spoolDirectory);
+		bool append(const char* data, size_t length); // False if the spool could not be written
+		// Spools the body now rather than at the memory limit (size known to exceed it)
+		bool spool();
+		// Moves up to `length` bytes from `socketFd` into the spool file through a pipe,
+		// without copying them through user space. Returns like recv(). EINVAL means
+		// splicing is unavailable and nothing was consumed; EIO, a failed spool write.
+		ssize_t spliceFrom(int socketFd, size_t length);
+		void reset();
+
+		bool isOpen() const;   // begin() was called: the request has a body, possibly empty
+		bool inMemory() const;
+		size_t size() const;
+		// The spool file, -1 while in memory. Reads here are positional, so its file
+		// offset is free for whoever the descriptor is handed to (a CGI's stdin).
+		int spoolFd() const;
+
+		// Copies up to `length` bytes from `offset`: the count, 0 past the end, or -1
+		ssize_t read(size_t offset, char* buffer, size_t length) const;
+		bool readAll(std::string& out) const;
+		// Stores the body at `destPath`, replacing any file there in one step: an
+		// O_TMPFILE spool on the same filesystem is linked into place, anything else
+		// is copied into a staging file first (see AtomicFile)
+		bool saveTo(const std::string& destPath) const;
+
+	private:
+		struct Shared {
+			std::string memory;
+			int fd;
+			bool linkable; // O_TMPFILE spool, which linkat() can give a name
+			std::string spoolDirectory;
+			size_t size;
+			size_t memoryLimit;
+			int refs;
+			Shared* nextFree;
+		};
+
+		enum {
+			POOL_MAX_BUFFERS = 16,
+			POOL_MAX_CAPACITY = 256 * 1024, // Larger buffers are freed rather than kept
+			SPLICE_PIPE_SIZE = 1024 * 1024  // Bytes moved per spliceFrom() call, at most
+		};
+
+		Shared* _shared;
+
+		void release();
+		static Shared* acquire();
+		static void recycle(Shared* shared);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef REQUESTPARSER_HPP
+#define REQUESTPARSER_HPP
+
+#include "webserv.hpp"
+
+// Incremental parser for a request line and header block. It never copies: the
+// method, URI, version and every field are recorded as (offset, length) slices
+// into the caller's buffer and only turned into strings when asked. Each call to
+// parse() picks up where the previous one stopped, so bytes that trickle in over
+// several reads are examined once rather than rescanned from the start.
+class RequestParser {
+	public:
+		struct Slice {
+			size_t offset;
+			size_t length;
+		};
+
+		struct Field {
+			Slice name;  // Without surrounding whitespace
+			Slice value; // Without surrounding whitespace
+		};
+
+		RequestParser();
+
+		// `data` must begin with the bytes seen by earlier calls since reset().
+		// True once the blank line ending the header block has been reached.
+		bool parse(const char* data, size_t length);
+		void reset(); // Keeps the field storage for the next request
+		bool started() const; // Some bytes have been examined since reset()
+		bool isComplete() const;
+		size_t headerLength() const; // Bytes up to and including the blank line
+
+		// Empty slices when the request line did not have three parts
+		const Slice& method() const;
+		const Slice& uri() const;
+		const Slice& version() const;
+		size_t fieldCount() const;
+		const Field& field(size_t index) const;
+
+		static std::string text(const char* data, const Slice& slice);
+
+	private:
+		enum Phase {
+			PHASE_REQUEST_LINE,
+			PHASE_FIELDS,
+			PHASE_DONE
+		};
+
+		Phase _phase;
+		size_t _lineStart; // Start of the line being assembled
+		size_t _scanned;   // Bytes already searched for its LF
+		Slice _method;
+		Slice _uri;
+		Slice _version;
+		std::vector<Field> _fields;
+
+		void parseRequestLine(const char* data, size_t start, size_t end);
+		void parseField(const char* data, size_t start, size_t end);
+};
+
+#endif
@@ -7,6 +7,11 @@
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
 #include "CGI.hpp"
+#include "EventLoop.hpp"
+#include "TimerWheel.hpp"
+#include "FileCache.hpp"
+#include "OpenFileCache.hpp"
+#include "Compressor.hpp"
 
 class Server {
 	public:
@@ -16,8 +21,14 @@ class Server {
 
 		// Core functionality
 		bool initialize();
+		bool openListeners();   // Create, bind and listen; may run in a master before fork()
+		bool setupEventLoop();  // Per-process/thread event loop over the listeners
 		void run();
 		void stop();
+		// Async-signal-safe; wakes the event loop, which then drains: see beginDrain()
+		void requestStop();
+		// Stops accepting. New connections are refused once no process holds the sockets.
+		void closeListeners();
 		
 		// Socket operations
 		bool createSockets();
@@ -29,10 +40,11 @@ class Server {
 		void removeClient(int clientFd);
 		
 		// HTTP handling
-		void processHttpRequest(int clientFd, const std::string& headers, const std::string& bodyFilePath);
-		void queueResponse(int clientFd, const HttpResponse& response);
+		void processHttpRequest(int clientFd, Client& client);
+		void queueResponse(int clientFd, HttpResponse& response); // Takes over the response body
 		HttpResponse handleGETRequest(const HttpRequest& request, const ServerConfig& serverConfig);
-		HttpResponse handlePOSTRequest(const HttpRequest& request, const ServerConfig& serverConfig);
+		HttpResponse handlePOSTRequest(const HttpRequest& request, const ServerConfig& serverConfig,
+									   const LocationConfig& location);
 		HttpResponse handlePUTRequest(const HttpRequest& request, const ServerConfig& serverConfig);
 		HttpResponse handleDELETERequest(const HttpRequest& request, const ServerConfig& serverConfig);
 		
@@ -42,7 +54,7 @@ class Server {
 		HttpResponse generateDirectoryListing(const std::string& path, const std::string& urlPath, const ServerConfig& serverConfig);
 		
 		// CGI handling
-		bool startAsyncCGI(int clientFd, const std::string& scriptPath, const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& locationConfig, const std::string& bodyFilePath = "");
+		bool startAsyncCGI(int clientFd, const std::string& scriptPath, const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& locationConfig);
 		void handleCgiCompletion(int cgiOutputFd);
 		void cleanupCgiProcess(int cgiOutputFd);
 		void processCgiQueue();
@@ -52,8 +64,8 @@ class Server {
 		HttpResponse handleFileUpload(const HttpRequest& request, const ServerConfig& serverConfig);
 		HttpResponse handleSimpleFileUpload(const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& location);
 		HttpResponse handleJSONPost(const HttpRequest& request, const ServerConfig& serverConfig);
-		bool saveUploadedFile(const std::string& filename, const std::string& content, const std::string& uploadPath);
-		bool saveUploadedFile(const std::string& filename, const std::string& srcFilePath, const std::string& uploadPath, bool isTempFile);
+		std::string uniqueUploadPath(const std::string& filename, const std::string& uploadPath);
+		bool saveUploadedFile(const std::string& filename, const RequestBody& body, const std::string& uploadPath);
 		
 		// Route handling
 		std::string resolveFilePath(const std::string& uri, const ServerConfig& serverConfig);
@@ -76,18 +88,42 @@ class Server {
 			int socket;
 			struct sockaddr_in addr;
 			ServerConfig config;
+
+			// Accept statistics, logged when the server stops
+			unsigned long accepted;
+			unsigned long acceptErrors;
+			unsigned long fullBatches;     // Wakeups that hit accept_batch with connections still queued
+			unsigned long peakRate;        // Highest connections/s seen over a one-second window
+			unsigned long windowAccepted;
+			uint64_t windowStart;
+			TimerWheel::TimerId resumeTimer; // Re-enables accepting after fd exhaustion
+
+			ServerInfo() : socket(-1), accepted(0), acceptErrors(0), fullBatches(0), peakRate(0),
+						   windowAccepted(0), windowStart(0), resumeTimer(TimerWheel::INVALID_TIMER) {
+				memset(&addr, 0, sizeof(addr));
+			}
 		};
 		
 		std::vector<ServerInfo> _servers;
-		std::vector<struct pollfd> _pollFds;
+		EventLoop _eventLoop;
 		std::map<int, Client> _clients;
-		std::map<int, std::string> _pendingWrites;
-		std::map<int, size_t> _writeOffsets;
 		std::map<int, ServerConfig> _serverConfigs; // Map socket fd to server config
 		std::map<int, int> _clientServerSockets; // Map client fd to server socket fd
 		Config _config;
-		bool _running;
-		time_t _lastTimeoutCheck;
+		volatile bool _running;
+		volatile bool _stopRequested;
+		bool _draining;
+		uint64_t _drainDeadline; // Loop clock (ms) at which a draining loop gives up waiting
+		int _wakePipe[2]; // Lets other threads / signal handlers interrupt the event loop
+		ServerConfig _defaultServerConfig;
+		
+		// Timeouts: one wheel timer per client and per CGI process
+		TimerWheel _timers;
+		uint64_t _now; // Monotonic loop clock (ms), refreshed once per wakeup
+		std::vector<TimerWheel::Expired> _expiredTimers;
+		std::vector<int> _pipelineResume; // Clients whose async response arrived with requests still buffered
+		FileCache _fileCache;
+		OpenFileCache _openFiles;
 		
 		// Asynchronous CGI management
 		struct CgiProcess {
@@ -95,14 +131,26 @@ class Server {
 			int inputFd;
 			int outputFd;
 			int clientFd;
-			time_t startTime;
+			TimerWheel::TimerId timer;
 			std::string output;
-			std::string bodyFilePath;
-			std::ifstream* bodyFile;
+			RequestBody body;      // Request body still to be written to the CGI's stdin
+			size_t bodyOffset;     // How much of it the CGI has taken so far
 			ServerConfig serverConfig;
+			LocationConfig locationConfig;
+
+			// Output compression: decided once the CGI's headers and gzip_min_length
+			// bytes of body are in, after which the body is compressed as it arrives
+			bool compressAllowed;  // Location has gzip on and the client accepts a coding
+			Compressor::Format compressFormat;
+			bool compressDecided;  // Until set, a known headerEnd means the headers allow compression
+			size_t headerEnd;      // Length of the CGI header block in `output`, npos until seen
+			size_t headerScanned;  // Bytes of `output` already searched for the header end
+			Compressor* compressor;
 
 			CgiProcess() : pid(-1), inputFd(-1), outputFd(-1), clientFd(-1), 
-						startTime(0), bodyFilePath(""), bodyFile(NULL) {}
+						timer(TimerWheel::INVALID_TIMER), bodyOffset(0),
+						compressAllowed(false), compressFormat(Compressor::FORMAT_GZIP), compressDecided(false),
+						headerEnd(std::string::npos), headerScanned(0), compressor(NULL) {}
 		};
 		
 		struct CgiRequest {
@@ -123,25 +171,48 @@ class Server {
 			HttpRequest request;
 			ServerConfig serverConfig;
 			LocationConfig locationConfig;
-			std::string bodyFilePath; // Path to temporary file containing request body
 		};
 		
 		std::vector<QueuedCgiRequest> _cgiQueue;
 		static const int MAX_CONCURRENT_CGI_PROCESSES = 5; // Increased for better performance
+		static const int ACCEPT_PAUSE_MS = 100; // Accept back-off after running out of descriptors
+		static const size_t OUTPUT_HIGH_WATER = 1024 * 1024; // Queued in-memory bytes at which a client stops being read
 
+		ServerInfo* findListener(int serverSocket);
+		bool registerClient(int clientFd, int serverSocket, const struct sockaddr_in& clientAddr);
+		void recordAccepts(ServerInfo& listener, int accepted, bool batchFull);
+		void pauseAccepting(ServerInfo& listener);
+		void processBufferedRequests(int clientFd);
+		void beginDrain();
+		bool isDrained() const;
+		static bool isIdle(const Client& client);
+		void awaitAsyncResponse(int clientFd);
+		void resumePipelinedRequests();
 		void updatePollEvents(int clientFd);
 		bool writeToClient(int clientFd);
 		void handleCgiWrite(int cgiInputFd);
-		ServerConfig getServerConfig(int clientFd) const;
-		
-		// Temporary file utilities for large body handling
-		std::string createTempFile();
-		bool writeBodyToFile(const std::string& body, const std::string& filePath);
-		std::string readBodyFromFile(const std::string& filePath);
-		void cleanupTempFile(const std::string& filePath);
+		void closeCgiInput(int cgiInputFd);
+		const ServerConfig& getServerConfig(int clientFd) const;
+		HttpResponse createCachedFileResponse(const FileCache::Entry& entry);
+		HttpResponse servePath(const std::string& filePath, const std::string& uri, const ServerConfig& serverConfig);
+		void invalidateCachedPath(const std::string& path);
+		
+		// Compression stage for generated responses
+		static bool compressionApplies(const LocationConfig& location, const std::string& contentType);
+		static bool negotiateCompression(const HttpRequest& request, Compressor::Format& format);
+		void compressResponse(const HttpRequest& request, const LocationConfig& location, HttpResponse& response);
+		bool appendCgiOutput(CgiProcess& cgiProc, const char* data, size_t length);
+		static size_t findCgiHeaderEnd(const std::string& output, size_t scanned);
+		static void parseCgiHeaders(const std::string& headers, HttpResponse& response);
+		bool findPrecompressed(const std::string& filePath, const HttpRequest& request, const ServerConfig& serverConfig,
+							   FileHandle& variant, std::string& encoding);
+		void warmFileCache();
 
-		void checkClientTimeouts();
-        void checkCgiTimeouts();
+		void refreshClientTimer(Client& client);
+		void processTimers();
+		void handleClientTimeout(int clientFd);
+		void handleCgiTimeout(int cgiOutputFd);
+		void failCgiProcess(int cgiOutputFd, int statusCode);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include "webserv.hpp"
+
+// Reference-counted immutable bytes. Copies share one buffer, which is freed when
+// the last copy goes away, so content held by the file cache can be queued on any
+// number of connections without being copied. Not shared across threads.
+class SharedBuffer {
+	public:
+		SharedBuffer();
+		SharedBuffer(const SharedBuffer& other);
+		SharedBuffer& operator=(const SharedBuffer& other);
+		~SharedBuffer();
+
+		// Takes over the contents of `data` by swap, leaving it empty
+		void adopt(std::string& data);
+		void reset();
+
+		bool empty() const;
+		const char* data() const;
+		size_t size() const;
+
+	private:
+		struct Shared {
+			std::string data;
+			int refs;
+		};
+
+		Shared* _shared;
+
+		void release();
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SUPERVISOR_HPP
+#define SUPERVISOR_HPP
+
+#include "webserv.hpp"
+#include "Config.hpp"
+#include <stdint.h>
+
+// Pre-fork master: opens the listeners once, forks worker processes that inherit
+// them, and respawns any worker that dies or outgrows worker_memory_limit. A
+// worker that keeps dying right after it starts is restarted with an increasing
+// delay instead of in a tight fork loop.
+class Supervisor {
+	public:
+		Supervisor(const Config& config);
+		~Supervisor();
+
+		bool initialize();
+		void run();
+		void requestStop(); // Async-signal-safe
+
+	private:
+		struct Worker {
+			pid_t pid;          // -1 while the slot is empty
+			uint64_t startedAt; // Monotonic clock (ms)
+			uint64_t respawnAt; // Earliest restart of an empty slot
+			int quickExits;     // Consecutive deaths within MIN_UPTIME_MS of starting
+
+			Worker() : pid(-1), startedAt(0), respawnAt(0), quickExits(0) {}
+		};
+
+		enum {
+			MIN_UPTIME_MS = 5000,      // Younger workers are not recycled, and count as crash-looping if they die
+			RESPAWN_DELAY_MS = 1000,   // After the first quick exit; doubled for each one after
+			MAX_RESPAWN_DELAY_MS = 60000,
+			STOP_GRACE_MS = 2000       // Beyond shutdown_timeout, before SIGKILL
+		};
+
+		Config _config;
+		Server* _server; // Owns the listening sockets; only workers run its event loop
+		std::vector<Worker> _workers;
+		std::vector<pid_t> _retiring; // Recycled workers draining after their replacement started
+		volatile sig_atomic_t _stopRequested;
+		bool _isWorker;
+
+		void spawnWorker(size_t slot);
+		void workerExited(size_t slot, int status);
+		void scheduleRespawn(size_t slot);
+		void reapWorkers();
+		void checkWorkerMemory();
+		void stopWorkers();
+		bool hasLiveWorkers() const;
+		size_t getResidentSize(pid_t pid) const;
+
+		Supervisor(const Supervisor&);
+		Supervisor& operator=(const Supervisor&);
+};
+
+#endif
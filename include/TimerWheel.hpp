@@ -0,0 +1,74 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include "webserv.hpp"
+#include <stdint.h>
+
+// Two-level hierarchical timer wheel driven by the event loop's cached monotonic
+// clock (milliseconds). Owners create a timer once and keep its id; arming,
+// re-arming and cancelling are O(1) list operations. Expiry walks only the slots
+// whose time has come, cascading the coarse level into the fine one as it wraps.
+class TimerWheel {
+	public:
+		typedef size_t TimerId;
+		static const TimerId INVALID_TIMER;
+
+		// What a timer belongs to; the key identifies the owner (e.g. a client fd)
+		enum TimerKind {
+			TIMER_CLIENT,
+			TIMER_CGI,
+			TIMER_LISTENER
+		};
+
+		struct Expired {
+			TimerId id;
+			TimerKind kind;
+			int key;
+		};
+
+		TimerWheel();
+
+		static uint64_t monotonicNow();
+		void reset(uint64_t now);
+
+		TimerId create(TimerKind kind, int key);
+		void release(TimerId id);
+		void arm(TimerId id, uint64_t deadline);
+		void cancel(TimerId id);
+		bool isArmed(TimerId id) const;
+
+		// Unlinks every timer due at `now` and appends it to `expired`
+		void expire(uint64_t now, std::vector<Expired>& expired);
+		// Milliseconds until the wheel next needs attention, -1 if nothing is armed
+		int nextTimeout(uint64_t now) const;
+
+	private:
+		enum {
+			TICK_MS = 100,
+			LEVEL0_BITS = 8,
+			LEVEL0_SIZE = 1 << LEVEL0_BITS, // 25.6 s at 100 ms per tick
+			LEVEL1_SIZE = 64                // ~27 min; later deadlines park in the last slot
+		};
+
+		struct Node {
+			uint64_t deadline;
+			TimerKind kind;
+			int key;
+			TimerId prev;
+			TimerId next;
+			int slot; // -1 when not armed
+			bool inUse;
+		};
+
+		std::vector<Node> _nodes;
+		std::vector<TimerId> _freeNodes;
+		TimerId _slots[LEVEL0_SIZE + LEVEL1_SIZE];
+		uint64_t _currentTick; // Next tick to be processed
+		size_t _armedCount;
+
+		void link(TimerId id);
+		void unlink(TimerId id);
+		void cascade(int slot);
+};
+
+#endif
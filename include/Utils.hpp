@@ -18,6 +18,7 @@ namespace Utils {
     bool isDirectory(const std::string& path);
     std::string readFile(const std::string& path);
     bool writeFile(const std::string& path, const std::string& content);
+    bool writeAll(int fd, const char* data, size_t length); // Retries short and interrupted writes
     std::string getDirectory(const std::string& path);
     std::string getBasename(const std::string& path);
     std::string getFileExtension(const std::string& path);
@@ -27,8 +28,10 @@ namespace Utils {
     std::string urlDecode(const std::string& str);
     std::string urlEncode(const std::string& str);
     std::string getMimeType(const std::string& extension);
-    std::string getCurrentTime();
+    const std::string& getCurrentTime();
     std::string formatTime(time_t time);
+    std::string formatHttpDate(time_t time); // IMF-fixdate, e.g. for Last-Modified
+    bool parseHttpDate(const std::string& date, time_t& time);
     
     // Network utilities
     std::string getClientIP(int socket);
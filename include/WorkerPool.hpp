@@ -0,0 +1,32 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include "webserv.hpp"
+#include "Config.hpp"
+#include <pthread.h>
+
+// Runs one independent Server event loop per worker thread. Each worker owns its
+// listeners (bound with SO_REUSEPORT), client table and CGI table.
+class WorkerPool {
+	public:
+		WorkerPool(const Config& config);
+		~WorkerPool();
+
+		bool initialize();
+		void run();
+		void requestStop(); // Async-signal-safe
+
+		size_t size() const;
+
+	private:
+		Config _config;
+		std::vector<Server*> _workers;
+		std::vector<pthread_t> _threads;
+
+		static void* workerMain(void* arg);
+
+		WorkerPool(const WorkerPool&);
+		WorkerPool& operator=(const WorkerPool&);
+};
+
+#endif
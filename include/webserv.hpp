@@ -49,11 +49,16 @@ struct LocationConfig {
     std::string cgiExtension;
     bool isRegex;
     size_t maxBodySize;
+    bool gzip;                          // Compress generated responses (CGI, listings, JSON)
+    int gzipCompLevel;
+    size_t gzipMinLength;               // Smaller bodies are sent as they are
+    std::vector<std::string> gzipTypes; // MIME types to compress, "*" for all
 };
 
 // Common constants
 #define BUFFER_SIZE 4096
 #define MAX_CONNECTIONS 1000
+#define MAX_WORKERS 64
 #define DEFAULT_PORT 8080
 #define DEFAULT_HOST "127.0.0.1"
 #define MAX_BODY_SIZE 1048576  // 1MB default
@@ -62,6 +67,7 @@ struct LocationConfig {
 #define HTTP_OK 200
 #define HTTP_CREATED 201
 #define HTTP_NO_CONTENT 204
+#define HTTP_PARTIAL_CONTENT 206
 #define HTTP_MOVED_PERMANENTLY 301
 #define HTTP_FOUND 302
 #define HTTP_BAD_REQUEST 400
@@ -70,8 +76,11 @@ struct LocationConfig {
 #define HTTP_METHOD_NOT_ALLOWED 405
 #define HTTP_REQUEST_TIMEOUT 408
 #define HTTP_PAYLOAD_TOO_LARGE 413
+#define HTTP_RANGE_NOT_SATISFIABLE 416
 #define HTTP_INTERNAL_SERVER_ERROR 500
 #define HTTP_NOT_IMPLEMENTED 501
+#define HTTP_BAD_GATEWAY 502
 #define HTTP_SERVICE_UNAVAILABLE 503
+#define HTTP_GATEWAY_TIMEOUT 504
 
 #endif
\ No newline at end of file
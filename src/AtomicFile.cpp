@@ -0,0 +1,138 @@
+#include "../include/AtomicFile.hpp"
+#include "../include/Utils.hpp"
+#include <cstdio>
+
+namespace {
+    std::string directoryOf(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        if (slash == std::string::npos) {
+            return ".";
+        }
+        return (slash == 0) ? "/" : path.substr(0, slash);
+    }
+
+    // A hidden name beside `destPath`, unique across processes and worker threads
+    std::string stagingName(const std::string& destPath) {
+        static int counter = 0;
+        std::ostringstream oss;
+        oss << directoryOf(destPath) << "/." << Utils::getBasename(destPath) << ".webserv-"
+            << getpid() << "-" << __sync_add_and_fetch(&counter, 1);
+        return oss.str();
+    }
+}
+
+AtomicFile::AtomicFile() : _fd(-1) {
+}
+
+AtomicFile::~AtomicFile() {
+    discard();
+}
+
+bool AtomicFile::open(const std::string& destPath) {
+    discard();
+    _destPath = destPath;
+#ifdef O_TMPFILE
+    _fd = ::open(directoryOf(destPath).c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    if (_fd >= 0) {
+        return true;
+    }
+#endif
+    _tempPath = stagingName(destPath);
+    _fd = ::open(_tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        Utils::logError("Failed to create " + _tempPath + ": " + strerror(errno));
+        _tempPath.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AtomicFile::write(const char* data, size_t length) {
+    return _fd >= 0 && Utils::writeAll(_fd, data, length);
+}
+
+bool AtomicFile::copyFrom(int sourceFd, size_t length) {
+    if (_fd < 0) {
+        return false;
+    }
+    off_t offset = 0;
+#ifdef __linux__
+    loff_t copyOffset = 0;
+    while (static_cast<size_t>(copyOffset) < length) {
+        ssize_t copied = copy_file_range(sourceFd, &copyOffset, _fd, NULL, length - static_cast<size_t>(copyOffset), 0);
+        if (copied > 0 || (copied < 0 && errno == EINTR)) {
+            continue;
+        }
+        break; // EXDEV, ENOSYS, EINVAL (memfd source, old kernel, ...): the rest by hand
+    }
+    offset = static_cast<off_t>(copyOffset);
+#endif
+    char buffer[65536];
+    while (static_cast<size_t>(offset) < length) {
+        size_t wanted = std::min(sizeof(buffer), length - static_cast<size_t>(offset));
+        ssize_t bytesRead = pread(sourceFd, buffer, wanted, offset);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0 || !Utils::writeAll(_fd, buffer, static_cast<size_t>(bytesRead))) {
+            return false;
+        }
+        offset += bytesRead;
+    }
+    return true;
+}
+
+bool AtomicFile::commit() {
+    if (_fd < 0) {
+        return false;
+    }
+    bool ok;
+    int error = 0;
+    if (_tempPath.empty()) {
+        ok = linkInto(_fd, _destPath);
+        error = errno;
+        close(_fd);
+    } else {
+        // Closed first: some filesystems only report a failed write on close
+        ok = close(_fd) == 0 && std::rename(_tempPath.c_str(), _destPath.c_str()) == 0;
+        error = errno;
+        if (ok) {
+            _tempPath.clear();
+        }
+    }
+    _fd = -1;
+    if (!ok) {
+        Utils::logError("Failed to move " + _destPath + " into place: " + strerror(error));
+        discard();
+    }
+    return ok;
+}
+
+void AtomicFile::discard() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    if (!_tempPath.empty()) {
+        unlink(_tempPath.c_str());
+        _tempPath.clear();
+    }
+}
+
+bool AtomicFile::linkInto(int fd, const std::string& destPath) {
+    std::ostringstream procPath;
+    procPath << "/proc/self/fd/" << fd;
+    // linkat() never replaces an existing file, so the link is made under a
+    // staging name and renamed over the destination
+    std::string staging = stagingName(destPath);
+    if (linkat(AT_FDCWD, procPath.str().c_str(), AT_FDCWD, staging.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+        return false;
+    }
+    if (std::rename(staging.c_str(), destPath.c_str()) != 0) {
+        int error = errno;
+        unlink(staging.c_str());
+        errno = error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+#include "../include/ByteScanner.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define BYTESCANNER_X86 1
+# include <immintrin.h>
+#endif
+
+namespace {
+    struct TokenTable {
+        bool allowed[256];
+
+        TokenTable() {
+            memset(allowed, 0, sizeof(allowed));
+            for (int c = '0'; c <= '9'; ++c) allowed[c] = true;
+            for (int c = 'A'; c <= 'Z'; ++c) allowed[c] = true;
+            for (int c = 'a'; c <= 'z'; ++c) allowed[c] = true;
+            const char* symbols = "!#$%&'*+-.^_`|~";
+            for (size_t i = 0; symbols[i]; ++i) {
+                allowed[static_cast<unsigned char>(symbols[i])] = true;
+            }
+        }
+
+        bool operator()(char c) const {
+            return allowed[static_cast<unsigned char>(c)];
+        }
+    };
+
+    const TokenTable isTokenChar;
+
+    size_t findLineEndScalar(const char* data, size_t length) {
+        const void* lf = memchr(data, '\n', length);
+        return lf ? static_cast<size_t>(static_cast<const char*>(lf) - data) : length;
+    }
+
+    size_t skipTokenScalar(const char* data, size_t pos, size_t length) {
+        while (pos < length && isTokenChar(data[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+#ifdef BYTESCANNER_X86
+    // The vector kernels classify the common token bytes (letters, digits, '-')
+    // in bulk; the first byte outside that set is settled by the table, and the
+    // scan resumes after it if it is one of the rarer tchar symbols.
+
+    __attribute__((target("sse2")))
+    size_t findLineEndSse2(const char* data, size_t length) {
+        const __m128i lf = _mm_set1_epi8('\n');
+        size_t pos = 0;
+        for (; pos + 16 <= length; pos += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+            if (mask) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+        return pos + findLineEndScalar(data + pos, length - pos);
+    }
+
+    __attribute__((target("sse2")))
+    size_t skipTokenSse2(const char* data, size_t length) {
+        const __m128i digitLow = _mm_set1_epi8('0' - 1);
+        const __m128i digitHigh = _mm_set1_epi8('9' + 1);
+        const __m128i alphaLow = _mm_set1_epi8('a' - 1);
+        const __m128i alphaHigh = _mm_set1_epi8('z' + 1);
+        const __m128i caseBit = _mm_set1_epi8(0x20);
+        const __m128i dash = _mm_set1_epi8('-');
+        size_t pos = 0;
+
+        while (pos + 16 <= length) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i folded = _mm_or_si128(block, caseBit); // 'A'..'Z' -> 'a'..'z'
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, digitLow), _mm_cmplt_epi8(block, digitHigh));
+            __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(folded, alphaLow), _mm_cmplt_epi8(folded, alphaHigh));
+            __m128i common = _mm_or_si128(_mm_or_si128(digit, alpha), _mm_cmpeq_epi8(block, dash));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(common)) ^ 0xFFFFu;
+            if (!mask) {
+                pos += 16;
+                continue;
+            }
+            pos += __builtin_ctz(mask);
+            if (!isTokenChar(data[pos])) {
+                return pos;
+            }
+            ++pos;
+        }
+        return skipTokenScalar(data, pos, length);
+    }
+#endif
+
+    const ByteScanner::Level activeLevel = ByteScanner::detectLevel();
+}
+
+size_t ByteScanner::findLineEnd(const char* data, size_t length) {
+    return findLineEnd(data, length, activeLevel);
+}
+
+size_t ByteScanner::skipToken(const char* data, size_t length) {
+    return skipToken(data, length, activeLevel);
+}
+
+size_t ByteScanner::findLineEnd(const char* data, size_t length, Level level) {
+#ifdef BYTESCANNER_X86
+    switch (level) {
+        case LEVEL_SSE2:
+            return findLineEndSse2(data, length);
+        default:
+            break;
+    }
+#endif
+    return findLineEndScalar(data, length);
+}
+
+size_t ByteScanner::skipToken(const char* data, size_t length, Level level) {
+#ifdef BYTESCANNER_X86
+    switch (level) {
+        case LEVEL_SSE2:
+            return skipTokenSse2(data, length);
+        default:
+            break;
+    }
+#endif
+    return skipTokenScalar(data, 0, length);
+}
+
+ByteScanner::Level ByteScanner::level() {
+    return activeLevel;
+}
+
+ByteScanner::Level ByteScanner::detectLevel() {
+#ifdef BYTESCANNER_X86
+    __builtin_cpu_init(); // May run from a static initializer, before libgcc's own
+    if (__builtin_cpu_supports("sse2")) {
+        return LEVEL_SSE2;
+    }
+#endif
+    return LEVEL_SCALAR;
+}
+
+const char* ByteScanner::levelName(Level level) {
+    switch (level) {
+        case LEVEL_SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
@@ -5,12 +5,12 @@
 #include <sstream>
 #include <unistd.h>
 
-CGI::CGI() {
+CGI::CGI() : _bodyLength(0) {
     setupCommonEnvVars();
 }
 
 CGI::CGI(const std::string& scriptPath, const std::string& interpreter) 
-    : _scriptPath(scriptPath), _interpreter(interpreter) {
+    : _scriptPath(scriptPath), _interpreter(interpreter), _bodyLength(0) {
     _scriptDir = extractDirectory(scriptPath);
     setupCommonEnvVars();
 }
@@ -29,22 +29,13 @@ void CGI::setInterpreter(const std::string& interpreter) {
 
 void CGI::setBody(const std::string& body) {
     _body = body;
+    _bodyLength = body.length();
 }
 
-void CGI::setBodyFromFile(const std::string& filePath) {
-    std::ifstream file(filePath.c_str(), std::ios::binary);
-    if (!file) {
-        Utils::logError("CGI: Failed to open body file: " + filePath);
-        _body = "";
-        return;
-    }
-    
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-    
-    _body = buffer.str();
-    Utils::logInfo("CGI: Read " + Utils::sizeToString(_body.length()) + " bytes from body file: " + filePath);
+void CGI::setBodyLength(size_t length) {
+    // The server streams the body into the CGI's stdin; only CONTENT_LENGTH is needed here
+    _body = "";
+    _bodyLength = length;
 }
 
 void CGI::setEnvironmentVariable(const std::string& key, const std::string& value) {
@@ -54,10 +45,9 @@ void CGI::setEnvironmentVariable(const std::string& key, const std::string& valu
 void CGI::setupEnvironment(const HttpRequest& request, const std::string& serverName, int serverPort) {
     _envVars["REQUEST_METHOD"] = request.getMethod();
     _envVars["REQUEST_URI"] = request.getUri();
-    _envVars["QUERY_STRING"] = request.getUri().find('?') != std::string::npos ? 
-                              request.getUri().substr(request.getUri().find('?') + 1) : "";
+    _envVars["QUERY_STRING"] = request.getQueryString(); // getUri() no longer carries it
     _envVars["CONTENT_TYPE"] = request.getHeader("content-type");
-	_envVars["CONTENT_LENGTH"] = Utils::sizeToString(_body.length());
+	_envVars["CONTENT_LENGTH"] = Utils::sizeToString(_bodyLength);
     _envVars["SERVER_NAME"] = serverName;
     _envVars["SERVER_PORT"] = Utils::intToString(serverPort);
     _envVars["SERVER_PROTOCOL"] = request.getVersion();
@@ -84,12 +74,11 @@ void CGI::setupEnvironment(const HttpRequest& request, const std::string& server
     _envVars["REMOTE_IDENT"] = "";
     
     // HTTP headers as environment variables
-    const std::map<std::string, std::string>& headers = request.getHeaders();
-    for (std::map<std::string, std::string>::const_iterator it = headers.begin(); 
-         it != headers.end(); ++it) {
-        std::string headerName = "HTTP_" + Utils::toUpper(it->first);
+    const HeaderTable& headers = request.getHeaders();
+    for (size_t i = 0; i < headers.size(); ++i) {
+        std::string headerName = "HTTP_" + Utils::toUpper(headers.nameAt(i));
         std::replace(headerName.begin(), headerName.end(), '-', '_');
-        _envVars[headerName] = it->second;
+        _envVars[headerName] = headers.valueAt(i);
     }
 }
 
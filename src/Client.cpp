@@ -8,48 +8,48 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <strings.h>
 #include <sstream>
 #include <limits>
 
-Client::Client() : _fd(-1), _state(STATE_READING_HEADERS), _bodyFile(NULL), 
+namespace {
+    bool containsIgnoreCase(const char* data, size_t length, const char* needle) {
+        size_t needleLength = strlen(needle);
+        for (size_t i = 0; i + needleLength <= length; ++i) {
+            if (strncasecmp(data + i, needle, needleLength) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+Client::Client() : _fd(-1), _serverConfig(NULL), _timer(TimerWheel::INVALID_TIMER), _headerTimerArmed(false), _awaitingResponse(false),
+                   _stopReading(false), _state(STATE_READING_HEADERS), _locationResolved(false),
                    _contentLength(0), _maxBodySize(0), _bodyBytesReceived(0), _currentChunkSize(0),
-                   _isChunked(false), _requestComplete(false), _closeConnectionAfterWrite(false) {}
+                   _isChunked(false), _bodyFailed(false), _spliceBody(false), _expectContinue(false), _requestComplete(false), _closeConnectionAfterWrite(false) {
+    memset(&_peerAddr, 0, sizeof(_peerAddr));
+}
 
-Client::Client(int fd) : _fd(fd), _lastActivity(time(NULL)), _stopReading(false),
-                         _state(STATE_READING_HEADERS), _bodyFile(NULL),
+Client::Client(int fd) : _fd(fd), _serverConfig(NULL), _timer(TimerWheel::INVALID_TIMER), _headerTimerArmed(false), _awaitingResponse(false),
+                         _stopReading(false),
+                         _state(STATE_READING_HEADERS), _locationResolved(false),
                          _contentLength(0), _maxBodySize(0), _bodyBytesReceived(0), _currentChunkSize(0),
-                         _isChunked(false), _requestComplete(false), _closeConnectionAfterWrite(false) {}
+                         _isChunked(false), _bodyFailed(false), _spliceBody(false), _expectContinue(false), _requestComplete(false), _closeConnectionAfterWrite(false) {
+    memset(&_peerAddr, 0, sizeof(_peerAddr));
+}
 
 Client::~Client() {
     clearRequest();
 }
 
-std::string Client::createTempFile() {
-    static int counter = 0;
-    std::ostringstream oss;
-    oss << "/tmp/webserv_body_" << getpid() << "_" << time(NULL) << "_" << (++counter);
-    return oss.str();
-}
-
-bool Client::openBodyFile() {
-    if (_bodyFile) return true;
-
-    _bodyFilePath = createTempFile();
-    _bodyFile = new std::ofstream(_bodyFilePath.c_str(), std::ios::binary);
-    if (!_bodyFile->is_open()) {
-        Utils::logError("Failed to create temporary body file: " + _bodyFilePath);
-        delete _bodyFile;
-        _bodyFile = NULL;
-        return false;
-    }
-    Utils::logInfo("Streaming request body to temp file: " + _bodyFilePath);
-    return true;
-}
-
 bool Client::readData() {
     if (_stopReading || _state == STATE_REQUEST_COMPLETE) {
         return true;
     }
+    if (_spliceBody && _state == STATE_READING_BODY && _buffer.empty()) {
+        return spliceBody();
+    }
     
     char buffer[BUFFER_SIZE];
     ssize_t bytesRead = recv(_fd, buffer, BUFFER_SIZE - 1, 0);
@@ -58,7 +58,6 @@ bool Client::readData() {
         // Successfully read new data
         buffer[bytesRead] = '\0';
         _buffer.append(buffer, bytesRead);
-        updateActivity();
 
         if (!_requestComplete) {
             _requestComplete = parseRequest();
@@ -86,54 +85,49 @@ bool Client::readData() {
 }
 
 bool Client::parseHeadersFromBuffer() {
-	size_t startPos = _buffer.find_first_not_of(" \t\r\n");
-    if (startPos == std::string::npos) {
-        // Buffer contains only whitespace
-        return false; 
-    }
-
-	size_t headerEndPos = _buffer.find("\r\n\r\n");
-
-    size_t headerEndLen = 4;
-    if (headerEndPos == std::string::npos) {
-        headerEndPos = _buffer.find("\n\n");
-        if (headerEndPos == std::string::npos) {
-            return false; // Headers not complete yet
+    if (!_parser.started()) {
+        size_t startPos = _buffer.find_first_not_of(" \t\r\n");
+        if (startPos == std::string::npos) {
+            // Buffer contains only whitespace (e.g. a stray CRLF after a pipelined body)
+            _buffer.clear();
+            return false;
         }
-        headerEndLen = 2;
+        _buffer.erase(0, startPos);
     }
-    headerEndPos += headerEndLen;
-    _headers = _buffer.substr(0, headerEndPos);
 
-	// Utils::logInfo("Client extracted headers block:\n--- START ---\n" + _headers + "--- END ---");
-    
-    size_t expectPos = _headers.find("Expect:");
-    if (expectPos == std::string::npos) expectPos = _headers.find("expect:");
-    if (expectPos != std::string::npos) {
-        if (_headers.find("100-continue", expectPos) != std::string::npos) {
-            const char *continue_msg = "HTTP/1.1 100 Continue\r\n\r\n";
-            send(_fd, continue_msg, strlen(continue_msg), 0);
-        }
-    }
-
-    size_t clPos = _headers.find("Content-Length:");
-    if (clPos == std::string::npos) clPos = _headers.find("content-length:");
-    if (clPos != std::string::npos) {
-        size_t lineEnd = _headers.find("\r\n", clPos);
-        if (lineEnd != std::string::npos) {
-            size_t valueStart = _headers.find(":", clPos);
-            if (valueStart != std::string::npos) {
-                std::string lenStr = _headers.substr(valueStart + 1, lineEnd - (valueStart + 1));
-                _contentLength = Utils::stringToInt(Utils::trim(lenStr));
-            }
-        }
+    // Resumes after the bytes examined on earlier reads
+    if (!_parser.parse(_buffer.data(), _buffer.length())) {
+        return false; // Headers not complete yet
     }
-
-    size_t tePos = _headers.find("Transfer-Encoding:");
-    if (tePos == std::string::npos) tePos = _headers.find("transfer-encoding:");
-    if (tePos != std::string::npos) {
-        if (_headers.find("chunked", tePos) != std::string::npos) {
-            _isChunked = true;
+    size_t headerEndPos = _parser.headerLength();
+
+    // The one HttpRequest for this request, built before the header bytes are dropped;
+    // framing fields are read straight from the parsed slices
+    const char* data = _buffer.data();
+    _request.parse(data, _parser);
+    _locationResolved = false;
+    for (size_t i = 0; i < _parser.fieldCount(); ++i) {
+        const RequestParser::Field& field = _parser.field(i);
+        const char* value = data + field.value.offset;
+        switch (HeaderTable::intern(data + field.name.offset, field.name.length)) {
+            case HeaderTable::HEADER_CONTENT_LENGTH:
+                _contentLength = 0;
+                for (size_t j = 0; j < field.value.length && isdigit(static_cast<unsigned char>(value[j])); ++j) {
+                    if (_contentLength > (std::numeric_limits<size_t>::max() - 9) / 10) {
+                        _contentLength = std::numeric_limits<size_t>::max(); // Rejected by the body size limit
+                        break;
+                    }
+                    _contentLength = _contentLength * 10 + (value[j] - '0');
+                }
+                break;
+            case HeaderTable::HEADER_TRANSFER_ENCODING:
+                _isChunked = containsIgnoreCase(value, field.value.length, "chunked");
+                break;
+            case HeaderTable::HEADER_EXPECT:
+                _expectContinue = containsIgnoreCase(value, field.value.length, "100-continue");
+                break;
+            default:
+                break;
         }
     }
 
@@ -142,7 +136,6 @@ bool Client::parseHeadersFromBuffer() {
 
     // --- Transition to next state ---
 	if (_contentLength > 0 || _isChunked) {
-        if (!openBodyFile()) return false; // Could not open file
         _state = STATE_HEADERS_COMPLETE;
     } else {
         // No body, request is complete
@@ -154,25 +147,63 @@ bool Client::parseHeadersFromBuffer() {
     return false; // Not complete yet, but headers are parsed
 }
 
+// The body could not be stored: stop reading and let the server answer 500
+bool Client::failBody() {
+    _stopReading = true;
+    _bodyFailed = true;
+    _state = STATE_REQUEST_COMPLETE;
+    _requestComplete = true;
+    return true;
+}
+
+// Content-Length bodies bound for the spool skip _buffer entirely; chunked ones
+// are always copied, since their framing has to be parsed out
+bool Client::spliceBody() {
+    ssize_t moved = _request.getBody().spliceFrom(_fd, _contentLength - _bodyBytesReceived);
+    if (moved > 0) {
+        _bodyBytesReceived += static_cast<size_t>(moved);
+        if (_bodyBytesReceived >= _contentLength) {
+            _state = STATE_REQUEST_COMPLETE;
+            _requestComplete = true;
+        }
+        return true;
+    }
+    if (moved == 0) {
+        return false; // Connection closed by peer
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return true;
+    }
+    if (errno == EINVAL) {
+        _spliceBody = false; // Not supported here; copy the rest through recv()
+        return readData();
+    }
+    if (errno == EIO) {
+        return failBody();
+    }
+    return false;
+}
+
 bool Client::handleBodyRead() {
     if (_buffer.empty()) return false;
 
-	size_t bytesToReceive = _buffer.length();
+	// Anything past Content-Length belongs to the next pipelined request
+	size_t bytesToReceive = std::min(_buffer.length(), _contentLength - _bodyBytesReceived);
     if (_bodyBytesReceived + bytesToReceive > _maxBodySize && _maxBodySize > 0) {
         Utils::logError("Body size exceeds limit. Stopping read.");
         _stopReading = true; // Stop reading from socket
-        _bodyFile->close();
         _state = STATE_REQUEST_COMPLETE;
 		_requestComplete = true;
         return true; // Mark as "complete" to trigger 413 in server
     }
 
-    _bodyFile->write(_buffer.c_str(), _buffer.length());
-    _bodyBytesReceived += _buffer.length();
-    _buffer.clear();
+    if (!_request.getBody().append(_buffer.data(), bytesToReceive)) {
+        return failBody();
+    }
+    _bodyBytesReceived += bytesToReceive;
+    _buffer.erase(0, bytesToReceive);
 
     if (_bodyBytesReceived >= _contentLength) {
-        _bodyFile->close();
         _state = STATE_REQUEST_COMPLETE;
 		_requestComplete = true;
         return true;
@@ -193,7 +224,6 @@ bool Client::handleChunkRead() {
 
             if (_currentChunkSize == 0) {
                 // End of chunks
-                _bodyFile->close();
                 _state = STATE_REQUEST_COMPLETE;
 				_requestComplete = true;
                 if (_buffer.rfind("\r\n", 0) == 0) {
@@ -205,7 +235,6 @@ bool Client::handleChunkRead() {
 				if (_bodyBytesReceived + _currentChunkSize > _maxBodySize && _maxBodySize > 0) {
 					Utils::logError("Chunked body size will exceed limit. Stopping read.");
 					_stopReading = true;
-					_bodyFile->close();
 					_state = STATE_REQUEST_COMPLETE;
 					_requestComplete = true;
 					return true; // Mark as "complete" to trigger 413
@@ -217,7 +246,9 @@ bool Client::handleChunkRead() {
             if (_buffer.empty()) return false; // Need more data
 
             size_t bytesToWrite = std::min(_buffer.length(), _currentChunkSize);
-            _bodyFile->write(_buffer.c_str(), bytesToWrite);
+            if (!_request.getBody().append(_buffer.data(), bytesToWrite)) {
+                return failBody();
+            }
             _buffer.erase(0, bytesToWrite);
             _currentChunkSize -= bytesToWrite;
 
@@ -282,22 +313,14 @@ bool Client::parseRequest() {
 }
 
 void Client::clearRequest() {
-    _buffer.clear();
-    _headers.clear();
+    _parser.reset();
+    _locationResolved = false;
     _requestComplete = false;
     
-    if (_bodyFile) {
-        if (_bodyFile->is_open()) {
-            _bodyFile->close();
-        }
-        delete _bodyFile;
-        _bodyFile = NULL;
-    }
-    // Don't delete the temp file here - Server owns it after processHttpRequest is called
-    // The Server will clean it up via cleanupTempFile()
-    if (!_bodyFilePath.empty()) {
-        _bodyFilePath.clear();
-    }
+    _request.getBody().reset(); // The server holds its own reference while it needs the body
+    _bodyFailed = false;
+    _spliceBody = false;
+    _expectContinue = false;
 
     _state = STATE_READING_HEADERS;
     _contentLength = 0;
@@ -306,6 +329,13 @@ void Client::clearRequest() {
     _isChunked = false;
 }
 
+bool Client::parseBufferedRequest() {
+    if (!_requestComplete && !_buffer.empty()) {
+        _requestComplete = parseRequest();
+    }
+    return _requestComplete;
+}
+
 int Client::getFd() const {
 	return _fd;
 }
@@ -314,12 +344,61 @@ const std::string& Client::getBuffer() const {
 	return _buffer;
 }
 
-time_t Client::getLastActivity() const {
-	return _lastActivity;
+const std::string& Client::getPeerAddress() {
+	if (_peerAddress.empty()) {
+		char buffer[INET_ADDRSTRLEN];
+		if (inet_ntop(AF_INET, &_peerAddr.sin_addr, buffer, sizeof(buffer))) {
+			_peerAddress = buffer;
+		} else {
+			_peerAddress = "unknown";
+		}
+	}
+	return _peerAddress;
+}
+
+void Client::setPeerAddress(const struct sockaddr_in& addr) {
+	_peerAddr = addr;
+	_peerAddress.clear();
+}
+
+const ServerConfig* Client::getServerConfig() const {
+	return _serverConfig;
+}
+
+void Client::setServerConfig(const ServerConfig* serverConfig) {
+	_serverConfig = serverConfig;
+}
+
+TimerWheel::TimerId Client::getTimer() const {
+	return _timer;
+}
+
+void Client::setTimer(TimerWheel::TimerId timer) {
+	_timer = timer;
+}
+
+bool Client::isHeaderTimerArmed() const {
+	return _headerTimerArmed;
+}
+
+void Client::setHeaderTimerArmed(bool armed) {
+	_headerTimerArmed = armed;
+}
+
+OutputQueue& Client::getOutput() {
+	return _output;
+}
+
+const OutputQueue& Client::getOutput() const {
+	return _output;
 }
 
-void Client::updateActivity() {
-	_lastActivity = time(NULL);
+bool Client::isAwaitingResponse() const {
+	return _awaitingResponse;
+}
+
+void Client::setAwaitingResponse(bool awaiting) {
+	_awaitingResponse = awaiting;
 }
 
 void Client::stopReading() {
@@ -334,14 +413,30 @@ bool Client::isRequestComplete() const {
 	return _requestComplete;
 }
 
-// Returns HEADERS ONLY
-const std::string& Client::getRequest() const {
-    return _headers;
+// Valid once the headers are complete; the body path is attached when the body is
+HttpRequest& Client::getRequest() {
+    return _request;
+}
+
+bool Client::hasLocation() const {
+    return _locationResolved;
+}
+
+const LocationConfig& Client::getLocation() const {
+    return _location;
+}
+
+void Client::setLocation(const LocationConfig& location) {
+    _location = location;
+    _locationResolved = true;
+}
+
+bool Client::hasBodyFailed() const {
+    return _bodyFailed;
 }
 
-// Returns path to body temp file
-const std::string& Client::getBodyFilePath() const {
-    return _bodyFilePath;
+bool Client::expectsContinue() const {
+    return _expectContinue;
 }
 
 bool Client::areHeadersComplete() const {
@@ -356,19 +451,19 @@ bool Client::isChunked() const {
     return _isChunked;
 }
 
-void Client::beginReadingBody(size_t maxBodySize) {
+void Client::beginReadingBody(size_t maxBodySize, size_t memoryLimit, const std::string& spoolDirectory) {
     if (_state != STATE_HEADERS_COMPLETE) {
         return;
     }
 
     _maxBodySize = (maxBodySize > 0) ? maxBodySize : std::numeric_limits<size_t>::max();
+    _request.getBody().begin(memoryLimit, spoolDirectory);
 
     // Server should have already checked this, but as a safety.
     if (_contentLength > 0 && _contentLength > _maxBodySize) {
         Utils::logError("Content-Length " + Utils::sizeToString(_contentLength) + 
                        " exceeds limit " + Utils::sizeToString(_maxBodySize));
         _stopReading = true;
-        _bodyFile->close();
         _state = STATE_REQUEST_COMPLETE;
 		_requestComplete = true;
         return;
@@ -378,6 +473,8 @@ void Client::beginReadingBody(size_t maxBodySize) {
         _state = STATE_READING_CHUNK_SIZE;
     } else if (_contentLength > 0) {
         _state = STATE_READING_BODY;
+        // Bound for the spool anyway: create it now so the socket can be spliced into it
+        _spliceBody = _contentLength > memoryLimit && _request.getBody().spool();
     } else {
         // No body, but headers were parsed.
         _state = STATE_REQUEST_COMPLETE;
@@ -0,0 +1,32 @@
+#include "../include/Clock.hpp"
+
+namespace {
+    // Per-thread so worker event loops never contend. __thread only takes POD, so
+    // the string itself is allocated on a thread's first update() and kept for
+    // the life of the thread.
+    __thread time_t t_second = -1;
+    __thread std::string* t_date = NULL;
+}
+
+void Clock::update() {
+    time_t now = time(NULL);
+    if (now == t_second) {
+        return;
+    }
+    struct tm timeinfo;
+    gmtime_r(&now, &timeinfo);
+    char buffer[32];
+    size_t length = strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+    if (!t_date) {
+        t_date = new std::string();
+    }
+    t_date->assign(buffer, length);
+    t_second = now;
+}
+
+const std::string& Clock::httpDate() {
+    if (!t_date) {
+        update(); // A thread that has not run its loop yet
+    }
+    return *t_date;
+}
@@ -0,0 +1,80 @@
+#include "../include/Compressor.hpp"
+
+Compressor::Compressor() : _active(false) {
+    memset(&_stream, 0, sizeof(_stream));
+}
+
+Compressor::~Compressor() {
+    reset();
+}
+
+bool Compressor::begin(Format format, int level) {
+    reset();
+    memset(&_stream, 0, sizeof(_stream));
+
+    // windowBits + 16 selects the gzip wrapper; plain 15 is the zlib wrapper HTTP calls "deflate"
+    int windowBits = (format == FORMAT_GZIP) ? 15 + 16 : 15;
+    if (deflateInit2(&_stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    _active = true;
+    return true;
+}
+
+bool Compressor::update(const char* data, size_t length, std::string& out) {
+    if (!_active) {
+        return false;
+    }
+    _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    _stream.avail_in = static_cast<uInt>(length);
+    return run(Z_NO_FLUSH, out);
+}
+
+bool Compressor::finish(std::string& out) {
+    if (!_active) {
+        return false;
+    }
+    _stream.next_in = NULL;
+    _stream.avail_in = 0;
+    bool ok = run(Z_FINISH, out);
+    reset();
+    return ok;
+}
+
+void Compressor::reset() {
+    if (_active) {
+        deflateEnd(&_stream);
+        _active = false;
+    }
+}
+
+const char* Compressor::encodingName(Format format) {
+    return (format == FORMAT_GZIP) ? "gzip" : "deflate";
+}
+
+bool Compressor::compress(Format format, int level, const std::string& in, std::string& out) {
+    Compressor compressor;
+    out.clear();
+    return compressor.begin(format, level) && compressor.update(in.data(), in.length(), out) && compressor.finish(out);
+}
+
+bool Compressor::run(int flush, std::string& out) {
+    char chunk[16384];
+    for (;;) {
+        _stream.next_out = reinterpret_cast<Bytef*>(chunk);
+        _stream.avail_out = sizeof(chunk);
+        int result = deflate(&_stream, flush);
+        if (result == Z_STREAM_ERROR || (result == Z_BUF_ERROR && flush == Z_FINISH)) {
+            return false;
+        }
+        out.append(chunk, sizeof(chunk) - _stream.avail_out);
+
+        if (flush == Z_FINISH) {
+            if (result == Z_STREAM_END) {
+                return true;
+            }
+        } else if (_stream.avail_in == 0 && _stream.avail_out != 0) {
+            return true; // All input consumed and nothing more pending
+        }
+    }
+}
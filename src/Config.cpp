@@ -2,9 +2,11 @@
 #include "../include/Utils.hpp"
 
 Config::Config() {
+    setGlobalDefaults(_global);
 }
 
 Config::Config(const std::string& configFile) : _configFile(configFile) {
+    setGlobalDefaults(_global);
 }
 
 Config::~Config() {
@@ -38,6 +40,8 @@ bool Config::parseFile(const std::string& filename) {
         return false;
     }
     
+    parseGlobalDirectives(content);
+    
     // Parse server blocks
     size_t pos = 0;
     while ((pos = content.find("server", pos)) != std::string::npos) {
@@ -194,14 +198,71 @@ bool Config::parseServerBlock(const std::string& block) {
             }
         } else if (directive == "keepalive_timeout") {
 			config.keepAliveTimeout = Utils::stringToInt(tokens[1]);
+		} else if (directive == "client_header_timeout") {
+			config.clientHeaderTimeout = Utils::stringToInt(tokens[1]);
 		} else if (directive == "cgi_timeout") {
 			config.cgiTimeout = Utils::stringToInt(tokens[1]);
+		} else if (directive == "client_body_buffer_size") {
+			config.clientBodyBufferSize = parseSize(tokens[1]);
+		} else if (directive == "gzip_static") {
+			config.gzipStatic = (tokens[1] == "on");
+		} else if (directive == "brotli_static") {
+			config.brotliStatic = (tokens[1] == "on");
 		}
 	}
     _servers.push_back(config);
     return true;
 }
 
+void Config::parseGlobalDirectives(const std::string& content) {
+    std::vector<std::string> lines = split(content, '\n');
+    int depth = 0;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string trimmedLine = trim(lines[i]);
+        int lineDepth = depth;
+        depth += std::count(trimmedLine.begin(), trimmedLine.end(), '{');
+        depth -= std::count(trimmedLine.begin(), trimmedLine.end(), '}');
+        
+        // Only top-level lines outside of server blocks are global directives
+        if (lineDepth != 0 || trimmedLine.empty() || trimmedLine[0] == '#') continue;
+        
+        std::vector<std::string> tokens = split(trimmedLine, ' ');
+        if (tokens.size() < 2 || tokens[0] == "server") continue;
+        
+        std::string directive = tokens[0];
+        
+        if (directive == "event_engine") {
+            _global.eventEngine = extractValue(trimmedLine);
+        } else if (directive == "worker_threads") {
+            _global.workerThreads = Utils::stringToInt(tokens[1]);
+        } else if (directive == "worker_processes") {
+            _global.workerProcesses = Utils::stringToInt(tokens[1]);
+        } else if (directive == "worker_memory_limit") {
+            _global.workerMemoryLimit = parseSize(tokens[1]);
+        } else if (directive == "accept_batch") {
+            _global.acceptBatch = Utils::stringToInt(tokens[1]);
+        } else if (directive == "shutdown_timeout") {
+            _global.shutdownTimeout = Utils::stringToInt(tokens[1]);
+        } else if (directive == "file_cache_size") {
+            _global.fileCacheSize = parseSize(tokens[1]);
+        } else if (directive == "file_cache_max_file") {
+            _global.fileCacheMaxFile = parseSize(tokens[1]);
+        } else if (directive == "file_cache_valid") {
+            _global.fileCacheValid = Utils::stringToInt(tokens[1]);
+        } else if (directive == "open_file_cache") {
+            _global.openFileCache = static_cast<size_t>(std::max(0, Utils::stringToInt(tokens[1])));
+        } else if (directive == "open_file_cache_valid") {
+            _global.openFileCacheValid = Utils::stringToInt(tokens[1]);
+        } else if (directive == "open_file_cache_errors") {
+            _global.openFileCacheErrors = (tokens[1] == "on");
+        } else if (directive == "file_cache_prewarm") {
+            std::vector<std::string> uris = extractValues(trimmedLine);
+            _global.fileCachePrewarm.insert(_global.fileCachePrewarm.end(), uris.begin(), uris.end());
+        }
+    }
+}
+
 bool Config::parseLocationBlock(const std::string& block, LocationConfig& location) {
     std::vector<std::string> lines = split(block, '\n');
     
@@ -232,6 +293,14 @@ bool Config::parseLocationBlock(const std::string& block, LocationConfig& locati
             location.cgiExtension = extractValue(trimmedLine);
         } else if (directive == "default") {
             location.index = extractValue(trimmedLine);
+        } else if (directive == "gzip") {
+            location.gzip = (tokens[1] == "on");
+        } else if (directive == "gzip_comp_level") {
+            location.gzipCompLevel = Utils::stringToInt(tokens[1]);
+        } else if (directive == "gzip_min_length") {
+            location.gzipMinLength = parseSize(tokens[1]);
+        } else if (directive == "gzip_types") {
+            location.gzipTypes = extractValues(trimmedLine);
         } else if (directive == "client_max_body_size") {
             std::string valueStr = extractValue(trimmedLine);
             size_t multiplier = 1;
@@ -271,6 +340,7 @@ void Config::setDefaults(ServerConfig& server) {
     server.root = "www";
     server.index = "index.html";
     server.maxBodySize = MAX_BODY_SIZE;
+    server.clientBodyBufferSize = 64 * 1024;
     server.autoIndex = false;
     server.uploadPath = "www/uploads";
     server.cgiPath = "www/cgi-bin";
@@ -293,7 +363,26 @@ void Config::setDefaults(ServerConfig& server) {
     server.cgiExtensions[".sh"] = "/bin/bash";
 
 	server.keepAliveTimeout = 60; // 60 seconds
+    server.clientHeaderTimeout = 60;
     server.cgiTimeout = 30;       // 30 seconds
+    server.gzipStatic = false;
+    server.brotliStatic = false;
+}
+
+void Config::setGlobalDefaults(GlobalConfig& global) {
+    global.eventEngine = "epoll";
+    global.workerThreads = 1;
+    global.workerProcesses = 0;
+    global.workerMemoryLimit = 0;
+    global.acceptBatch = 64;
+    global.shutdownTimeout = 10;
+    global.fileCacheSize = 16 * 1024 * 1024;
+    global.fileCacheMaxFile = 1024 * 1024;
+    global.fileCacheValid = 5;
+    global.fileCachePrewarm.clear();
+    global.openFileCache = 128;
+    global.openFileCacheValid = 5;
+    global.openFileCacheErrors = true;
 }
 
 void Config::setLocationDefaults(LocationConfig& location) const {
@@ -305,6 +394,10 @@ void Config::setLocationDefaults(LocationConfig& location) const {
     location.cgiExtension = "";
     location.isRegex = false;
     location.maxBodySize = 0; // 0 means inherit from server config
+    location.gzip = false;
+    location.gzipCompLevel = 1;
+    location.gzipMinLength = 20;
+    location.gzipTypes.assign(1, "text/html");
     
     location.allowedMethods.push_back("GET");
     location.allowedMethods.push_back("POST");
@@ -315,6 +408,10 @@ const std::vector<ServerConfig>& Config::getServers() const {
     return _servers;
 }
 
+const GlobalConfig& Config::getGlobalConfig() const {
+    return _global;
+}
+
 ServerConfig Config::getDefaultServer() const {
     if (_servers.empty()) {
         ServerConfig defaultConfig;
@@ -474,6 +571,46 @@ bool Config::validate() const {
         return false;
     }
     
+    if (_global.eventEngine != "epoll" && _global.eventEngine != "poll") {
+        Utils::logError("Invalid event_engine: " + _global.eventEngine);
+        return false;
+    }
+    
+    if (_global.workerThreads < 1 || _global.workerThreads > MAX_WORKERS) {
+        Utils::logError("Invalid worker_threads: " + Utils::intToString(_global.workerThreads));
+        return false;
+    }
+    
+    if (_global.workerProcesses < 0 || _global.workerProcesses > MAX_WORKERS) {
+        Utils::logError("Invalid worker_processes: " + Utils::intToString(_global.workerProcesses));
+        return false;
+    }
+    
+    if (_global.acceptBatch < 1) {
+        Utils::logError("Invalid accept_batch: " + Utils::intToString(_global.acceptBatch));
+        return false;
+    }
+    
+    if (_global.shutdownTimeout < 0) {
+        Utils::logError("Invalid shutdown_timeout: " + Utils::intToString(_global.shutdownTimeout));
+        return false;
+    }
+    
+    if (_global.fileCacheValid < 0) {
+        Utils::logError("Invalid file_cache_valid: " + Utils::intToString(_global.fileCacheValid));
+        return false;
+    }
+    
+    if (_global.openFileCacheValid < 0) {
+        Utils::logError("Invalid open_file_cache_valid: " + Utils::intToString(_global.openFileCacheValid));
+        return false;
+    }
+    
+    if (_global.workerProcesses > 0 && _global.workerThreads > 1) {
+        Utils::logError("worker_processes and worker_threads cannot be combined");
+        return false;
+    }
+    
     for (size_t i = 0; i < _servers.size(); ++i) {
         const ServerConfig& server = _servers[i];
         if (server.port <= 0 || server.port > 65535) {
@@ -490,6 +627,14 @@ bool Config::validate() const {
             Utils::logError("Empty root directory");
             return false;
         }
+        
+        for (size_t j = 0; j < server.locations.size(); ++j) {
+            int level = server.locations[j].gzipCompLevel;
+            if (level < 1 || level > 9) {
+                Utils::logError("Invalid gzip_comp_level in location " + server.locations[j].path + ": " + Utils::intToString(level));
+                return false;
+            }
+        }
     }
     
     return true;
@@ -562,4 +707,25 @@ std::vector<std::string> Config::extractValues(const std::string& line) {
     
     std::string valuesStr = line.substr(firstSpace + 1);
     return split(trim(valuesStr), ' ');
-}
\ No newline at end of file
+}
+
+size_t Config::parseSize(const std::string& value) {
+    std::string valueStr = value;
+    size_t multiplier = 1;
+    
+    // Handle size suffixes (K, M, G)
+    if (!valueStr.empty()) {
+        char lastChar = valueStr[valueStr.length() - 1];
+        if (lastChar == 'K' || lastChar == 'k') {
+            multiplier = 1024;
+            valueStr = valueStr.substr(0, valueStr.length() - 1);
+        } else if (lastChar == 'M' || lastChar == 'm') {
+            multiplier = 1024 * 1024;
+            valueStr = valueStr.substr(0, valueStr.length() - 1);
+        } else if (lastChar == 'G' || lastChar == 'g') {
+            multiplier = 1024 * 1024 * 1024;
+            valueStr = valueStr.substr(0, valueStr.length() - 1);
+        }
+    }
+    return static_cast<size_t>(strtoul(valueStr.c_str(), NULL, 10)) * multiplier;
+}
@@ -0,0 +1,267 @@
+#include "../include/EventLoop.hpp"
+#include "../include/Utils.hpp"
+
+static short toPollEvents(int events) {
+    short mask = 0;
+    if (events & EventLoop::EVENT_READ) mask |= POLLIN;
+    if (events & EventLoop::EVENT_WRITE) mask |= POLLOUT;
+    return mask;
+}
+
+#ifdef __linux__
+static uint32_t toEpollEvents(int events) {
+    uint32_t mask = 0;
+    if (events & EventLoop::EVENT_READ) mask |= EPOLLIN;
+    if (events & EventLoop::EVENT_WRITE) mask |= EPOLLOUT;
+    return mask;
+}
+#endif
+
+EventLoop::EventLoop() : _engine(ENGINE_POLL), _epollFd(-1) {
+}
+
+EventLoop::~EventLoop() {
+    close();
+}
+
+bool EventLoop::open(Engine engine) {
+    close();
+    _engine = engine;
+
+#ifdef __linux__
+    if (_engine == ENGINE_EPOLL) {
+        _epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFd >= 0) {
+            _epollEvents.resize(MAX_CONNECTIONS);
+            return true;
+        }
+        Utils::logError("epoll_create1 failed, falling back to poll: " + std::string(strerror(errno)));
+    }
+#endif
+
+    _engine = ENGINE_POLL;
+    return true;
+}
+
+void EventLoop::close() {
+    if (_epollFd >= 0) {
+        ::close(_epollFd);
+        _epollFd = -1;
+    }
+    _entries.clear();
+    _pollFds.clear();
+}
+
+EventLoop::Engine EventLoop::getEngine() const {
+    return _engine;
+}
+
+const char* EventLoop::engineName(Engine engine) {
+    switch (engine) {
+        case ENGINE_EPOLL: return "epoll";
+        case ENGINE_POLL: return "poll";
+    }
+    return "unknown";
+}
+
+bool EventLoop::parseEngine(const std::string& name, Engine& engine) {
+    if (name == "epoll") {
+        engine = ENGINE_EPOLL;
+    } else if (name == "poll") {
+        engine = ENGINE_POLL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+EventLoop::Entry* EventLoop::lookup(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= _entries.size()) {
+        return NULL;
+    }
+    Entry* entry = &_entries[fd];
+    return (entry->type == HANDLER_NONE) ? NULL : entry;
+}
+
+bool EventLoop::add(int fd, HandlerType type, int events) {
+    if (fd < 0 || type == HANDLER_NONE) {
+        return false;
+    }
+    if (static_cast<size_t>(fd) >= _entries.size()) {
+        _entries.resize(fd + 1);
+    }
+
+    Entry& entry = _entries[fd];
+    if (entry.type != HANDLER_NONE) {
+        // Already registered; treat as a re-registration
+        entry.type = type;
+        return modify(fd, events);
+    }
+
+#ifdef __linux__
+    if (_engine == ENGINE_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = toEpollEvents(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            Utils::logError("epoll_ctl(ADD) failed for fd " + Utils::intToString(fd) + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+#endif
+
+    if (_engine == ENGINE_POLL) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = toPollEvents(events);
+        pfd.revents = 0;
+        entry.pollIndex = _pollFds.size();
+        _pollFds.push_back(pfd);
+    }
+
+    entry.type = type;
+    entry.events = events;
+    ++entry.generation;
+    return true;
+}
+
+bool EventLoop::modify(int fd, int events) {
+    Entry* entry = lookup(fd);
+    if (!entry) {
+        return false;
+    }
+    if (entry->events == events) {
+        return true;
+    }
+
+#ifdef __linux__
+    if (_engine == ENGINE_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = toEpollEvents(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            Utils::logError("epoll_ctl(MOD) failed for fd " + Utils::intToString(fd) + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+#endif
+
+    if (_engine == ENGINE_POLL) {
+        _pollFds[entry->pollIndex].events = toPollEvents(events);
+    }
+
+    entry->events = events;
+    return true;
+}
+
+void EventLoop::remove(int fd) {
+    Entry* entry = lookup(fd);
+    if (!entry) {
+        return;
+    }
+
+#ifdef __linux__
+    if (_engine == ENGINE_EPOLL) {
+        // Harmless if the fd was already closed (the kernel dropped it then)
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif
+
+    if (_engine == ENGINE_POLL) {
+        // Swap the last pollfd into the hole so removal stays O(1)
+        size_t index = entry->pollIndex;
+        size_t last = _pollFds.size() - 1;
+        if (index != last) {
+            _pollFds[index] = _pollFds[last];
+            _entries[_pollFds[index].fd].pollIndex = index;
+        }
+        _pollFds.pop_back();
+    }
+
+    entry->type = HANDLER_NONE;
+    entry->events = 0;
+    entry->pollIndex = 0;
+}
+
+EventLoop::HandlerType EventLoop::getType(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= _entries.size()) {
+        return HANDLER_NONE;
+    }
+    return _entries[fd].type;
+}
+
+int EventLoop::wait(std::vector<Event>& ready, int timeoutMs) {
+    ready.clear();
+#ifdef __linux__
+    if (_engine == ENGINE_EPOLL) {
+        return waitEpoll(ready, timeoutMs);
+    }
+#endif
+    return waitPoll(ready, timeoutMs);
+}
+
+bool EventLoop::isCurrent(const Event& event) const {
+    if (event.fd < 0 || static_cast<size_t>(event.fd) >= _entries.size()) {
+        return false;
+    }
+    const Entry& entry = _entries[event.fd];
+    return entry.type == event.type && entry.generation == event.generation;
+}
+
+int EventLoop::waitPoll(std::vector<Event>& ready, int timeoutMs) {
+    int result = poll(_pollFds.empty() ? NULL : &_pollFds[0], _pollFds.size(), timeoutMs);
+    if (result <= 0) {
+        return result;
+    }
+
+    // Snapshot the ready set so handlers may add/remove fds while we dispatch
+    for (size_t i = 0; i < _pollFds.size() && static_cast<int>(ready.size()) < result; ++i) {
+        const struct pollfd& pfd = _pollFds[i];
+        if (pfd.revents == 0) {
+            continue;
+        }
+        Event event;
+        event.fd = pfd.fd;
+        event.type = _entries[pfd.fd].type;
+        event.generation = _entries[pfd.fd].generation;
+        event.events = 0;
+        if (pfd.revents & POLLIN) event.events |= EVENT_READ;
+        if (pfd.revents & POLLOUT) event.events |= EVENT_WRITE;
+        if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) event.events |= EVENT_ERROR;
+        ready.push_back(event);
+    }
+    return static_cast<int>(ready.size());
+}
+
+int EventLoop::waitEpoll(std::vector<Event>& ready, int timeoutMs) {
+#ifdef __linux__
+    int result = epoll_wait(_epollFd, &_epollEvents[0], _epollEvents.size(), timeoutMs);
+    if (result <= 0) {
+        return result;
+    }
+
+    for (int i = 0; i < result; ++i) {
+        const struct epoll_event& ev = _epollEvents[i];
+        int fd = ev.data.fd;
+        if (fd < 0 || static_cast<size_t>(fd) >= _entries.size()) {
+            continue;
+        }
+        Event event;
+        event.fd = fd;
+        event.type = _entries[fd].type;
+        event.generation = _entries[fd].generation;
+        event.events = 0;
+        if (ev.events & EPOLLIN) event.events |= EVENT_READ;
+        if (ev.events & EPOLLOUT) event.events |= EVENT_WRITE;
+        if (ev.events & (EPOLLHUP | EPOLLERR)) event.events |= EVENT_ERROR;
+        ready.push_back(event);
+    }
+    return static_cast<int>(ready.size());
+#else
+    (void)ready;
+    (void)timeoutMs;
+    return -1;
+#endif
+}
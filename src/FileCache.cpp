@@ -0,0 +1,244 @@
+#include "../include/FileCache.hpp"
+#include "../include/Utils.hpp"
+
+#ifdef __linux__
+# include <sys/inotify.h>
+#endif
+
+FileCache::FileCache() : _bytes(0), _maxBytes(0), _maxFileSize(0), _validMs(0), _watchFd(-1), _hits(0), _misses(0) {
+}
+
+FileCache::~FileCache() {
+    close();
+}
+
+void FileCache::configure(size_t maxBytes, size_t maxFileSize, int validSeconds) {
+    _maxBytes = maxBytes;
+    _maxFileSize = std::min(maxFileSize, maxBytes);
+    _validMs = static_cast<uint64_t>(validSeconds) * 1000;
+}
+
+bool FileCache::isEnabled() const {
+    return _maxBytes > 0;
+}
+
+bool FileCache::openWatcher() {
+#ifdef __linux__
+    if (_watchFd < 0) {
+        _watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#endif
+    return _watchFd >= 0;
+}
+
+void FileCache::close() {
+    _entries.clear();
+    _lru.clear();
+    _bytes = 0;
+    _watchDirs.clear();
+    _dirWatches.clear();
+    if (_watchFd >= 0) {
+        ::close(_watchFd); // Drops every watch with it
+        _watchFd = -1;
+    }
+}
+
+int FileCache::watchFd() const {
+    return _watchFd;
+}
+
+const FileCache::Entry* FileCache::lookup(const std::string& key, uint64_t now) {
+    std::map<std::string, Entry>::iterator it = _entries.find(key);
+    if (it == _entries.end()) {
+        ++_misses;
+        return NULL;
+    }
+
+    Entry& entry = it->second;
+    if (!entry.watched && now - entry.validatedAt >= _validMs) {
+        struct stat st;
+        if (stat(entry.source.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+            st.st_ino != entry.inode || st.st_dev != entry.device ||
+            st.st_mtime != entry.mtime || static_cast<size_t>(st.st_size) != entry.content.size()) {
+            erase(it);
+            ++_misses;
+            return NULL;
+        }
+        entry.validatedAt = now;
+    }
+
+    _lru.splice(_lru.begin(), _lru, entry.lru);
+    ++_hits;
+    return &entry;
+}
+
+const FileCache::Entry* FileCache::insert(const std::string& key, const FileHandle& file, const std::string& mimeType,
+                                         const std::string& etag, uint64_t now) {
+    if (!isEnabled() || !file.isOpen() || file.size() > _maxFileSize) {
+        return NULL;
+    }
+
+    // Watch before reading, so a change made after the read cannot go unnoticed. A
+    // symlink's target may live in another directory whose edits the watch would
+    // miss, so symlinked files are revalidated by stat() instead.
+    const std::string& source = file.path();
+    struct stat st;
+    if (lstat(source.c_str(), &st) != 0) {
+        return NULL;
+    }
+    bool watched = !S_ISLNK(st.st_mode) && watchDirectory(Utils::getDirectory(source));
+
+    std::string content(file.size(), '\0');
+    size_t done = 0;
+    while (done < content.size()) {
+        ssize_t bytesRead = pread(file.fd(), &content[done], content.size() - done, static_cast<off_t>(done));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return NULL; // Error or the file shrank; serve it uncached
+        }
+        done += static_cast<size_t>(bytesRead);
+    }
+
+    // The file may have been replaced between open() and the watch being set up;
+    // a same-size rename within the same second only shows in the inode
+    if (stat(source.c_str(), &st) != 0 || st.st_ino != file.inode() || st.st_dev != file.device() ||
+        st.st_mtime != file.mtime() || static_cast<size_t>(st.st_size) != content.size()) {
+        return NULL;
+    }
+
+    std::map<std::string, Entry>::iterator existing = _entries.find(key);
+    if (existing != _entries.end()) {
+        erase(existing);
+    }
+    evict(content.size());
+
+    _lru.push_front(key);
+    Entry& entry = _entries[key];
+    entry.source = source;
+    entry.content.adopt(content);
+    entry.mimeType = mimeType;
+    entry.etag = etag;
+    entry.mtime = file.mtime();
+    entry.inode = file.inode();
+    entry.device = file.device();
+    entry.lastModified = Utils::formatHttpDate(entry.mtime);
+    entry.validatedAt = now;
+    entry.watched = watched;
+    entry.lru = _lru.begin();
+    _bytes += entry.content.size();
+    return &entry;
+}
+
+void FileCache::invalidate(const std::string& path) {
+    std::map<std::string, Entry>::iterator it = _entries.begin();
+    while (it != _entries.end()) {
+        std::map<std::string, Entry>::iterator current = it++;
+        if (current->first == path || current->second.source == path) {
+            erase(current);
+        }
+    }
+}
+
+void FileCache::processWatchEvents(std::vector<std::string>& changed) {
+#ifdef __linux__
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t length = read(_watchFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (ssize_t pos = 0; pos < length; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; nothing in the cache can be trusted any more
+                _entries.clear();
+                _lru.clear();
+                _bytes = 0;
+                continue;
+            }
+
+            std::map<int, std::string>::iterator watch = _watchDirs.find(event->wd);
+            if (watch == _watchDirs.end()) {
+                continue;
+            }
+            std::string dir = watch->second;
+
+            if (event->mask & (IN_IGNORED | IN_MOVE_SELF | IN_DELETE_SELF)) {
+                // The directory itself went away: forget the watch and everything under it
+                if (!(event->mask & IN_IGNORED)) {
+                    inotify_rm_watch(_watchFd, event->wd);
+                }
+                _dirWatches.erase(dir);
+                _watchDirs.erase(watch);
+                std::map<std::string, Entry>::iterator it = _entries.begin();
+                while (it != _entries.end()) {
+                    std::map<std::string, Entry>::iterator current = it++;
+                    if (Utils::getDirectory(current->second.source) == dir) {
+                        erase(current);
+                    }
+                }
+            } else if (event->len > 0) {
+                std::string name(event->name);
+                changed.push_back(dir.empty() ? name : dir + "/" + name);
+                invalidate(changed.back());
+            }
+        }
+    }
+#else
+    (void)changed;
+#endif
+}
+
+size_t FileCache::bytes() const {
+    return _bytes;
+}
+
+unsigned long FileCache::hits() const {
+    return _hits;
+}
+
+unsigned long FileCache::misses() const {
+    return _misses;
+}
+
+bool FileCache::watchDirectory(const std::string& dir) {
+#ifdef __linux__
+    if (_watchFd < 0) {
+        return false;
+    }
+    if (_dirWatches.find(dir) != _dirWatches.end()) {
+        return true;
+    }
+
+    int wd = inotify_add_watch(_watchFd, dir.empty() ? "." : dir.c_str(),
+                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0) {
+        return false;
+    }
+    _watchDirs[wd] = dir;
+    _dirWatches[dir] = wd;
+    return true;
+#else
+    (void)dir;
+    return false;
+#endif
+}
+
+void FileCache::erase(std::map<std::string, Entry>::iterator it) {
+    _bytes -= it->second.content.size();
+    _lru.erase(it->second.lru);
+    _entries.erase(it);
+}
+
+void FileCache::evict(size_t needed) {
+    while (!_lru.empty() && _bytes + needed > _maxBytes) {
+        erase(_entries.find(_lru.back()));
+    }
+}
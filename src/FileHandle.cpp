@@ -0,0 +1,97 @@
+#include "../include/FileHandle.hpp"
+
+FileHandle::FileHandle() : _shared(NULL) {
+}
+
+FileHandle::FileHandle(const FileHandle& other) : _shared(other._shared) {
+    if (_shared) {
+        ++_shared->refs;
+    }
+}
+
+FileHandle& FileHandle::operator=(const FileHandle& other) {
+    if (_shared != other._shared) {
+        release();
+        _shared = other._shared;
+        if (_shared) {
+            ++_shared->refs;
+        }
+    }
+    return *this;
+}
+
+FileHandle::~FileHandle() {
+    release();
+}
+
+bool FileHandle::open(const std::string& path) {
+    release();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int savedErrno = errno;
+        ::close(fd);
+        errno = savedErrno;
+        return false;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        ::close(fd);
+        errno = EISDIR;
+        return false;
+    }
+
+    _shared = new Shared;
+    _shared->fd = fd;
+    _shared->size = static_cast<size_t>(st.st_size);
+    _shared->mtime = st.st_mtime;
+    _shared->inode = st.st_ino;
+    _shared->device = st.st_dev;
+    _shared->path = path;
+    _shared->refs = 1;
+    return true;
+}
+
+void FileHandle::reset() {
+    release();
+}
+
+bool FileHandle::isOpen() const {
+    return _shared != NULL;
+}
+
+int FileHandle::fd() const {
+    return _shared ? _shared->fd : -1;
+}
+
+size_t FileHandle::size() const {
+    return _shared ? _shared->size : 0;
+}
+
+time_t FileHandle::mtime() const {
+    return _shared ? _shared->mtime : 0;
+}
+
+ino_t FileHandle::inode() const {
+    return _shared ? _shared->inode : 0;
+}
+
+dev_t FileHandle::device() const {
+    return _shared ? _shared->device : 0;
+}
+
+const std::string& FileHandle::path() const {
+    static const std::string none;
+    return _shared ? _shared->path : none;
+}
+
+void FileHandle::release() {
+    if (_shared && --_shared->refs == 0) {
+        ::close(_shared->fd);
+        delete _shared;
+    }
+    _shared = NULL;
+}
@@ -0,0 +1,221 @@
+#include "../include/HeaderTable.hpp"
+
+namespace {
+    struct KnownName {
+        const char* name;
+        size_t length;
+    };
+
+    // Indexed by HeaderTable::Name
+    const KnownName KNOWN_NAMES[] = {
+        { "Server", 6 },
+        { "Date", 4 },
+        { "Content-Type", 12 },
+        { "Content-Length", 14 },
+        { "Connection", 10 },
+        { "Location", 8 },
+        { "ETag", 4 },
+        { "Last-Modified", 13 },
+        { "Accept-Ranges", 13 },
+        { "Content-Range", 13 },
+        { "Content-Encoding", 16 },
+        { "Vary", 4 },
+        { "Transfer-Encoding", 17 },
+        { "Host", 4 },
+        { "User-Agent", 10 },
+        { "Accept", 6 },
+        { "Accept-Encoding", 15 },
+        { "Range", 5 },
+        { "If-Range", 8 },
+        { "If-None-Match", 13 },
+        { "If-Modified-Since", 17 },
+        { "Expect", 6 },
+        { "Cookie", 6 },
+        { "Set-Cookie", 10 },
+        { "Cache-Control", 13 },
+        { "Allow", 5 },
+        { "Keep-Alive", 10 }
+    };
+
+    bool equalsIgnoreCase(const char* a, const char* b, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+HeaderTable::HeaderTable() : _count(0) {
+}
+
+void HeaderTable::set(const std::string& name, const std::string& value) {
+    Name known = intern(name.data(), name.length());
+    size_t index = indexOf(known, name);
+    if (index < _count) {
+        field(index).value = value;
+        return;
+    }
+    Field& added = append(known);
+    if (known == HEADER_UNKNOWN) {
+        added.name = name;
+    }
+    added.value = value;
+}
+
+void HeaderTable::set(Name name, const std::string& value) {
+    size_t index = indexOf(name, std::string());
+    if (index < _count) {
+        field(index).value = value;
+    } else {
+        append(name).value = value;
+    }
+}
+
+void HeaderTable::setNumber(Name name, size_t value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* start = end;
+    do {
+        *--start = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    size_t index = indexOf(name, std::string());
+    Field& target = (index < _count) ? field(index) : append(name);
+    target.value.assign(start, end - start);
+}
+
+const std::string* HeaderTable::find(const std::string& name) const {
+    size_t index = indexOf(intern(name.data(), name.length()), name);
+    return (index < _count) ? &field(index).value : NULL;
+}
+
+const std::string* HeaderTable::find(Name name) const {
+    size_t index = indexOf(name, std::string());
+    return (index < _count) ? &field(index).value : NULL;
+}
+
+void HeaderTable::remove(const std::string& name) {
+    size_t index = indexOf(intern(name.data(), name.length()), name);
+    if (index < _count) {
+        erase(index);
+    }
+}
+
+void HeaderTable::remove(Name name) {
+    size_t index = indexOf(name, std::string());
+    if (index < _count) {
+        erase(index);
+    }
+}
+
+void HeaderTable::clear() {
+    for (size_t i = 0; i < _count && i < INLINE_CAPACITY; ++i) {
+        _inline[i].name.clear();
+        _inline[i].value.clear();
+    }
+    _overflow.clear();
+    _count = 0;
+}
+
+size_t HeaderTable::size() const {
+    return _count;
+}
+
+std::string HeaderTable::nameAt(size_t index) const {
+    const Field& f = field(index);
+    return (f.known == HEADER_UNKNOWN) ? f.name : std::string(KNOWN_NAMES[f.known].name, KNOWN_NAMES[f.known].length);
+}
+
+const std::string& HeaderTable::valueAt(size_t index) const {
+    return field(index).value;
+}
+
+void HeaderTable::serialize(std::string& out) const {
+    out.reserve(out.length() + serializedLength());
+    for (size_t i = 0; i < _count; ++i) {
+        const Field& f = field(i);
+        if (f.known == HEADER_UNKNOWN) {
+            out.append(f.name);
+        } else {
+            out.append(KNOWN_NAMES[f.known].name, KNOWN_NAMES[f.known].length);
+        }
+        out.append(": ", 2);
+        out.append(f.value);
+        out.append("\r\n", 2);
+    }
+}
+
+size_t HeaderTable::serializedLength() const {
+    size_t length = 0;
+    for (size_t i = 0; i < _count; ++i) {
+        const Field& f = field(i);
+        length += (f.known == HEADER_UNKNOWN) ? f.name.length() : KNOWN_NAMES[f.known].length;
+        length += f.value.length() + 4; // ": " and CRLF
+    }
+    return length;
+}
+
+HeaderTable::Name HeaderTable::intern(const char* name, size_t length) {
+    for (size_t i = 0; i < sizeof(KNOWN_NAMES) / sizeof(KNOWN_NAMES[0]); ++i) {
+        if (KNOWN_NAMES[i].length == length && equalsIgnoreCase(KNOWN_NAMES[i].name, name, length)) {
+            return static_cast<Name>(i);
+        }
+    }
+    return HEADER_UNKNOWN;
+}
+
+const char* HeaderTable::canonicalName(Name name) {
+    return (name == HEADER_UNKNOWN) ? "" : KNOWN_NAMES[name].name;
+}
+
+HeaderTable::Field& HeaderTable::field(size_t index) {
+    return (index < INLINE_CAPACITY) ? _inline[index] : _overflow[index - INLINE_CAPACITY];
+}
+
+const HeaderTable::Field& HeaderTable::field(size_t index) const {
+    return (index < INLINE_CAPACITY) ? _inline[index] : _overflow[index - INLINE_CAPACITY];
+}
+
+size_t HeaderTable::indexOf(Name known, const std::string& name) const {
+    for (size_t i = 0; i < _count; ++i) {
+        const Field& f = field(i);
+        if (f.known != known) {
+            continue;
+        }
+        if (known != HEADER_UNKNOWN ||
+            (f.name.length() == name.length() && equalsIgnoreCase(f.name.data(), name.data(), name.length()))) {
+            return i;
+        }
+    }
+    return _count;
+}
+
+HeaderTable::Field& HeaderTable::append(Name known) {
+    if (_count >= INLINE_CAPACITY) {
+        _overflow.push_back(Field());
+    }
+    Field& added = field(_count++);
+    added.known = known;
+    return added;
+}
+
+// Shifts the later fields down by swapping, so their strings move without copying
+void HeaderTable::erase(size_t index) {
+    for (size_t i = index; i + 1 < _count; ++i) {
+        Field& current = field(i);
+        Field& next = field(i + 1);
+        current.known = next.known;
+        current.name.swap(next.name);
+        current.value.swap(next.value);
+    }
+    --_count;
+    if (_count >= INLINE_CAPACITY) {
+        _overflow.pop_back();
+    } else {
+        _inline[_count].name.clear();
+        _inline[_count].value.clear();
+    }
+}
@@ -1,88 +1,68 @@
 #include "../include/HttpRequest.hpp"
 #include "../include/Utils.hpp"
 
-HttpRequest::HttpRequest() : _isValid(false) {
+namespace {
+    bool equalsIgnoreCase(const char* a, const char* b, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+HttpRequest::HttpRequest() : _headersMaterialized(true), _queryParamsParsed(true), _isValid(false) {
 }
 
-HttpRequest::HttpRequest(const std::string& headers, const std::string& bodyFilePath) 
-    : _bodyFilePath(bodyFilePath), _isValid(false) 
-{
-    parse(headers, bodyFilePath);
+HttpRequest::HttpRequest(const std::string& headers) : _headersMaterialized(true), _queryParamsParsed(true), _isValid(false) {
+    parse(headers);
 }
 
 HttpRequest::~HttpRequest() {
 }
 
-bool HttpRequest::parse(const std::string& headers, const std::string& bodyFilePath) {
+bool HttpRequest::parse(const std::string& headers) {
     _isValid = false; // Start as invalid
     if (headers.empty()) {
         return false;
     }
 
-	size_t reqLineStart = headers.find_first_not_of(" \t\r\n");
-        if (reqLineStart == std::string::npos) {
-            Utils::logError("Headers block contains only whitespace.");
-            return false; // Only whitespace found
-        }
-
-	// Find the end of the *actual* request line, searching from reqLineStart
-    size_t firstLineEnd = headers.find("\r\n", reqLineStart);
-    size_t firstLineEndLen = 2;
-    if (firstLineEnd == std::string::npos) {
-        firstLineEnd = headers.find("\n", reqLineStart);
-        if (firstLineEnd == std::string::npos) {
-            Utils::logError("Could not find end of first request line after position " + Utils::sizeToString(reqLineStart));
-            return false; // No line ending found after the start
-        }
-        firstLineEndLen = 1;
+    RequestParser parser;
+    if (!parser.parse(headers.data(), headers.length())) {
+        Utils::logError("Malformed headers: No final empty line found.");
+        return false;
     }
-
-    // Extract the request line using the correct start and end
-    std::string firstLineRaw = headers.substr(reqLineStart, firstLineEnd - reqLineStart);
-    // Utils::logInfo("HttpRequest received raw first line: [" + firstLineRaw + "]");
-
-    parseRequestLine(Utils::trim(firstLineRaw));
+    return parse(headers.data(), parser);
+}
+
+bool HttpRequest::parse(const char* data, const RequestParser& parser) {
+    _isValid = false;
+    _headers.clear();
+    _headersMaterialized = true;
+    _body.reset();
+    _queryString.clear();
+    _queryParams.clear();
+    _queryParamsParsed = true;
+
+    // The request line is always needed, so it is copied out now
+    _method = Utils::toUpper(RequestParser::text(data, parser.method()));
+    _uri = RequestParser::text(data, parser.uri());
+    _version = RequestParser::text(data, parser.version());
     if (_method.empty()) {
         Utils::logError("Request line parsing failed.");
         return false;
     }
 
-    // Adjust headerStart to be after the first line's actual ending
-    size_t headerStart = firstLineEnd + firstLineEndLen;
-
-    std::vector<std::string> headerLines;
-    size_t currentPos = headerStart;
-
-    while (currentPos < headers.length()) {
-        size_t nextLineEnd = headers.find("\r\n", currentPos);
-        size_t nextLineEndLen = 2;
-        if (nextLineEnd == std::string::npos) {
-            nextLineEnd = headers.find("\n", currentPos);
-            if (nextLineEnd != std::string::npos) {
-                nextLineEndLen = 1;
-            } else {
-                // This means we reached the end of the headers string without finding \r\n\r\n or \n\n
-                // which shouldn't happen if Client::parseHeadersFromBuffer worked.
-                Utils::logError("Malformed headers: No final empty line found.");
-                break; 
-            }
-        }
-
-        // Extract the line content *before* the line ending
-        std::string line = Utils::trim(headers.substr(currentPos, nextLineEnd - currentPos));
-
-        if (line.empty()) {
-            // Found the empty line separating headers from body
-            break;
-        }
-
-        headerLines.push_back(line);
-        currentPos = nextLineEnd + nextLineEndLen;
+    // Fields stay slices over one copy of the header block; both buffers keep their
+    // capacity from the previous request on the connection, so usually nothing is allocated
+    _headerBlock.assign(data, parser.headerLength());
+    _fields.clear();
+    for (size_t i = 0; i < parser.fieldCount(); ++i) {
+        _fields.push_back(parser.field(i));
     }
+    _headersMaterialized = _fields.empty();
 
-    parseHeaders(headerLines);
-
-    _bodyFilePath = bodyFilePath;
     parseQueryString(_uri); // Make sure this happens after getting _uri
 
     // Final validity check
@@ -93,56 +73,12 @@ bool HttpRequest::parse(const std::string& headers, const std::string& bodyFileP
     return _isValid;
 }
 
-void HttpRequest::parseRequestLine(const std::string& line) {
-    std::vector<std::string> parts = Utils::split(line, ' ');
-    // Filter out empty strings that might result from multiple spaces
-    std::vector<std::string> validParts;
-    for (size_t i = 0; i < parts.size(); ++i) {
-        if (!parts[i].empty()) {
-            validParts.push_back(parts[i]);
-        }
-    }
-
-    if (validParts.size() >= 3) {
-        _method = Utils::toUpper(validParts[0]);
-        _uri = validParts[1];
-        _version = validParts[2]; // Take the first 3 valid parts
-    } else {
-        // Explicitly clear fields if parsing fails
-        _method.clear();
-        _uri.clear();
-        _version.clear();
-        Utils::logError("Failed to parse request line: '" + line + "'"); // Add logging
-    }
-}
-
-void HttpRequest::parseHeaders(const std::vector<std::string>& headerLines) {
-    for (size_t i = 0; i < headerLines.size(); ++i) {
-        const std::string& line = headerLines[i];
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = Utils::trim(line.substr(0, colonPos));
-            std::string value = Utils::trim(line.substr(colonPos + 1));
-            _headers[Utils::toLower(key)] = value;
-        }
-    }
-}
-
 void HttpRequest::parseQueryString(const std::string& uri) {
     size_t queryPos = uri.find('?');
     if (queryPos != std::string::npos) {
-        std::string queryString = uri.substr(queryPos + 1);
-        std::vector<std::string> params = Utils::split(queryString, '&');
-        
-        for (size_t i = 0; i < params.size(); ++i) {
-            const std::string& param = params[i];
-            size_t equalPos = param.find('=');
-            if (equalPos != std::string::npos) {
-                std::string key = Utils::urlDecode(param.substr(0, equalPos));
-                std::string value = Utils::urlDecode(param.substr(equalPos + 1));
-                _queryParams[key] = value;
-            }
-        }
+        // Kept raw; the parameters are only decoded if someone asks for them
+        _queryString = uri.substr(queryPos + 1);
+        _queryParamsParsed = false;
         
         // Remove query string from URI
         _uri = uri.substr(0, queryPos);
@@ -161,22 +97,50 @@ const std::string& HttpRequest::getVersion() const {
     return _version;
 }
 
-const std::string& HttpRequest::getBodyFilePath() const {
-	return _bodyFilePath;
+const RequestBody& HttpRequest::getBody() const {
+	return _body;
 }
 
-const std::map<std::string, std::string>& HttpRequest::getHeaders() const {
+RequestBody& HttpRequest::getBody() {
+	return _body;
+}
+
+const HeaderTable& HttpRequest::getHeaders() const {
+    if (!_headersMaterialized) {
+        const char* data = _headerBlock.data();
+        for (size_t i = 0; i < _fields.size(); ++i) {
+            _headers.set(RequestParser::text(data, _fields[i].name), RequestParser::text(data, _fields[i].value));
+        }
+        _headersMaterialized = true;
+    }
     return _headers;
 }
 
+const std::string& HttpRequest::getQueryString() const {
+    return _queryString;
+}
+
 const std::map<std::string, std::string>& HttpRequest::getQueryParams() const {
+    if (!_queryParamsParsed) {
+        _queryParams.clear();
+        std::vector<std::string> params = Utils::split(_queryString, '&');
+        for (size_t i = 0; i < params.size(); ++i) {
+            const std::string& param = params[i];
+            size_t equalPos = param.find('=');
+            if (equalPos != std::string::npos) {
+                std::string key = Utils::urlDecode(param.substr(0, equalPos));
+                std::string value = Utils::urlDecode(param.substr(equalPos + 1));
+                _queryParams[key] = value;
+            }
+        }
+        _queryParamsParsed = true;
+    }
     return _queryParams;
 }
 
 std::string HttpRequest::getHeader(const std::string& key) const {
-    std::string lowerKey = Utils::toLower(key);
-    std::map<std::string, std::string>::const_iterator it = _headers.find(lowerKey);
-    return (it != _headers.end()) ? it->second : "";
+    const RequestParser::Field* field = findField(key);
+    return field ? RequestParser::text(_headerBlock.data(), field->value) : "";
 }
 
 bool HttpRequest::isValid() const {
@@ -188,10 +152,52 @@ std::string HttpRequest::getPath() const {
 }
 
 bool HttpRequest::hasHeader(const std::string& key) const {
-    return _headers.find(Utils::toLower(key)) != _headers.end();
+    return findField(key) != NULL;
 }
 
 size_t HttpRequest::getContentLength() const {
     std::string contentLength = getHeader("content-length");
     return contentLength.empty() ? 0 : Utils::stringToInt(contentLength);
 }
+
+bool HttpRequest::acceptsEncoding(const std::string& coding) const {
+    std::vector<std::string> items = Utils::split(getHeader("accept-encoding"), ',');
+    bool wildcard = false;
+    
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::vector<std::string> params = Utils::split(items[i], ';');
+        if (params.empty()) {
+            continue;
+        }
+        std::string name = Utils::toLower(Utils::trim(params[0]));
+        
+        // "q=0" (in any spelling such as "q=0.000") marks the coding as unacceptable
+        bool acceptable = true;
+        for (size_t j = 1; j < params.size(); ++j) {
+            std::string param = Utils::toLower(Utils::trim(params[j]));
+            if (Utils::startsWith(param, "q=")) {
+                acceptable = strtod(param.c_str() + 2, NULL) > 0.0;
+            }
+        }
+        
+        if (name == coding) {
+            return acceptable;
+        }
+        if (name == "*") {
+            wildcard = acceptable;
+        }
+    }
+    return wildcard;
+}
+
+// Searches backwards so a repeated field resolves to its last value, as HeaderTable::set would
+const RequestParser::Field* HttpRequest::findField(const std::string& key) const {
+    const char* data = _headerBlock.data();
+    for (size_t i = _fields.size(); i > 0; --i) {
+        const RequestParser::Field& field = _fields[i - 1];
+        if (field.name.length == key.length() && equalsIgnoreCase(data + field.name.offset, key.data(), key.length())) {
+            return &field;
+        }
+    }
+    return NULL;
+}
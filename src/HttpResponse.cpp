@@ -1,16 +1,17 @@
 #include "../include/HttpResponse.hpp"
 #include "../include/Utils.hpp"
+#include "../include/Clock.hpp"
 
-HttpResponse::HttpResponse() : _statusCode(200), _version("HTTP/1.1") {
+HttpResponse::HttpResponse() : _statusCode(200), _compressible(false), _version("HTTP/1.1") {
     setStatus(200);
-    setHeader("Server", "webserv/1.0");
-    setHeader("Date", Utils::getCurrentTime());
+    _headers.set(HeaderTable::HEADER_SERVER, "webserv/1.0");
+    _headers.set(HeaderTable::HEADER_DATE, Clock::httpDate());
 }
 
-HttpResponse::HttpResponse(int statusCode) : _statusCode(statusCode), _version("HTTP/1.1") {
+HttpResponse::HttpResponse(int statusCode) : _statusCode(statusCode), _compressible(false), _version("HTTP/1.1") {
     setStatus(statusCode);
-    setHeader("Server", "webserv/1.0");
-    setHeader("Date", Utils::getCurrentTime());
+    _headers.set(HeaderTable::HEADER_SERVER, "webserv/1.0");
+    _headers.set(HeaderTable::HEADER_DATE, Clock::httpDate());
 }
 
 HttpResponse::~HttpResponse() {
@@ -35,23 +36,30 @@ const std::string& HttpResponse::getStatusMessage() const {
 }
 
 void HttpResponse::setHeader(const std::string& key, const std::string& value) {
-    _headers[key] = value;
+    _headers.set(key, value);
 }
 
 void HttpResponse::setContentType(const std::string& type) {
-    setHeader("Content-Type", type);
+    _headers.set(HeaderTable::HEADER_CONTENT_TYPE, type);
 }
 
 void HttpResponse::setContentLength(size_t length) {
-    setHeader("Content-Length", Utils::sizeToString(length));
+    _headers.setNumber(HeaderTable::HEADER_CONTENT_LENGTH, length);
 }
 
 std::string HttpResponse::getHeader(const std::string& key) const {
-    std::map<std::string, std::string>::const_iterator it = _headers.find(key);
-    return (it != _headers.end()) ? it->second : "";
+    const std::string* value = _headers.find(key);
+    return value ? *value : "";
+}
+
+void HttpResponse::removeHeader(const std::string& key) {
+    _headers.remove(key);
 }
 
 void HttpResponse::setBody(const std::string& body) {
+    _bodyFile.reset();
+    _bodyFileParts.clear();
+    _sharedBody.reset();
     _body = body;
     setContentLength(_body.length());
 }
@@ -65,29 +73,295 @@ const std::string& HttpResponse::getBody() const {
     return _body;
 }
 
-std::string HttpResponse::toString() const {
-    std::string response = _version + " " + Utils::intToString(_statusCode) + " " + _statusMessage + "\r\n";
+void HttpResponse::takeBody(std::string& out) {
+    out.clear();
+    out.swap(_body);
+}
+
+void HttpResponse::setBodyFile(const FileHandle& file, off_t offset, size_t length) {
+    _body.clear();
+    _sharedBody.reset();
+    _bodyFile = file;
+    _bodyFileParts.assign(1, FilePart());
+    _bodyFileParts[0].offset = offset;
+    _bodyFileParts[0].length = length;
+    setContentLength(length);
+}
+
+void HttpResponse::setSharedBody(const SharedBuffer& body) {
+    _body.clear();
+    _bodyFile.reset();
+    _bodyFileParts.clear();
+    _sharedBody = body;
+    setContentLength(_sharedBody.size());
+}
+
+bool HttpResponse::hasSharedBody() const {
+    return !_sharedBody.empty();
+}
+
+const SharedBuffer& HttpResponse::getSharedBody() const {
+    return _sharedBody;
+}
+
+bool HttpResponse::hasBodyFile() const {
+    return _bodyFile.isOpen();
+}
+
+const FileHandle& HttpResponse::getBodyFile() const {
+    return _bodyFile;
+}
+
+const std::vector<HttpResponse::FilePart>& HttpResponse::getBodyFileParts() const {
+    return _bodyFileParts;
+}
+
+HttpResponse::RangeResult HttpResponse::applyRange(const std::string& range, const std::string* ifRange) {
+    if (range.empty() || _statusCode != HTTP_OK || _bodyFileParts.size() != 1) {
+        return RANGE_IGNORED;
+    }
+    
+    // If-Range: a stale validator means the client's partial copy is outdated, so it
+    // gets the whole file. Entity tags need a strong match; dates an exact one.
+    if (ifRange) {
+        std::string validator = Utils::trim(*ifRange);
+        if (validator.empty()) {
+            return RANGE_IGNORED; // Blank If-Range matches nothing
+        }
+        bool isTag = validator[0] == '"' || Utils::startsWith(validator, "W/");
+        std::string current = getHeader(isTag ? "ETag" : "Last-Modified");
+        if (current.empty() || validator != current || Utils::startsWith(validator, "W/")) {
+            return RANGE_IGNORED;
+        }
+    }
+    
+    const FilePart whole = _bodyFileParts[0];
+    std::vector<std::pair<size_t, size_t> > ranges;
+    if (!parseRanges(range, whole.length, ranges)) {
+        return RANGE_IGNORED;
+    }
+    if (ranges.empty()) {
+        setStatus(HTTP_RANGE_NOT_SATISFIABLE);
+        return RANGE_UNSATISFIABLE;
+    }
+    
+    std::string total = Utils::sizeToString(whole.length);
+    setStatus(HTTP_PARTIAL_CONTENT);
+    _bodyFileParts.clear();
+    
+    if (ranges.size() == 1) {
+        FilePart part;
+        part.offset = whole.offset + ranges[0].first;
+        part.length = ranges[0].second - ranges[0].first + 1;
+        _bodyFileParts.push_back(part);
+        setHeader("Content-Range", "bytes " + Utils::sizeToString(ranges[0].first) + "-" +
+                  Utils::sizeToString(ranges[0].second) + "/" + total);
+        setContentLength(part.length);
+        return RANGE_APPLIED;
+    }
+    
+    // multipart/byteranges: each slice gets its own part header, the closing
+    // delimiter rides in the string body behind the last slice
+    std::string boundary = "webserv" + Utils::sizeToString(whole.length) + "x" +
+                           Utils::sizeToString(static_cast<size_t>(_bodyFile.mtime())) + "x" +
+                           Utils::sizeToString(ranges.size());
+    std::string partType = getHeader("Content-Type");
+    size_t length = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        FilePart part;
+        part.header = (i == 0 ? "" : "\r\n");
+        part.header += "--" + boundary + "\r\n";
+        if (!partType.empty()) {
+            part.header += "Content-Type: " + partType + "\r\n";
+        }
+        part.header += "Content-Range: bytes " + Utils::sizeToString(ranges[i].first) + "-" +
+                       Utils::sizeToString(ranges[i].second) + "/" + total + "\r\n\r\n";
+        part.offset = whole.offset + ranges[i].first;
+        part.length = ranges[i].second - ranges[i].first + 1;
+        length += part.header.length() + part.length;
+        _bodyFileParts.push_back(part);
+    }
+    _body = "\r\n--" + boundary + "--\r\n";
+    length += _body.length();
+    
+    setContentType("multipart/byteranges; boundary=" + boundary);
+    setContentLength(length);
+    return RANGE_APPLIED;
+}
+
+bool HttpResponse::isNotModified(const std::string& ifNoneMatch, const std::string& ifModifiedSince) const {
+    if (_statusCode != HTTP_OK) {
+        return false;
+    }
+    
+    if (!ifNoneMatch.empty()) {
+        // Weak comparison: W/"x" and "x" match; If-Modified-Since is then ignored
+        std::string etag = getHeader("ETag");
+        if (etag.empty()) {
+            return false;
+        }
+        std::string opaque = Utils::startsWith(etag, "W/") ? etag.substr(2) : etag;
+        std::vector<std::string> tags = Utils::split(ifNoneMatch, ',');
+        for (size_t i = 0; i < tags.size(); ++i) {
+            std::string tag = Utils::trim(tags[i]);
+            if (Utils::startsWith(tag, "W/")) {
+                tag = tag.substr(2);
+            }
+            if (tag == "*" || tag == opaque) {
+                return true;
+            }
+        }
+        return false;
+    }
     
-    // Add headers
-    for (std::map<std::string, std::string>::const_iterator it = _headers.begin(); it != _headers.end(); ++it) {
-        response += it->first + ": " + it->second + "\r\n";
+    if (!ifModifiedSince.empty()) {
+        time_t since;
+        time_t modified;
+        std::string lastModified = getHeader("Last-Modified");
+        if (!lastModified.empty() && Utils::parseHttpDate(Utils::trim(ifModifiedSince), since) &&
+            Utils::parseHttpDate(lastModified, modified)) {
+            return modified <= since;
+        }
     }
+    return false;
+}
+
+void HttpResponse::setNotModified() {
+    setStatus(304);
+    dropBody();
+    removeHeader("Content-Length");
+    removeHeader("Content-Type");
+    removeHeader("Accept-Ranges");
+}
+
+// Parses "bytes=a-b, c-, -n" into inclusive offsets clamped to the file. Returns false
+// when the header is malformed or not worth honoring (it is then ignored); an empty
+// result means every range lies past the end of the file.
+bool HttpResponse::parseRanges(const std::string& range, size_t fileSize, std::vector<std::pair<size_t, size_t> >& ranges) {
+    static const size_t MAX_RANGES = 32;
     
-    response += "\r\n"; // Empty line separating headers from body
-    response += _body;
+    std::string spec = Utils::trim(range);
+    if (Utils::toLower(spec.substr(0, 6)) != "bytes=") {
+        return false;
+    }
+    std::vector<std::string> items = Utils::split(spec.substr(6), ',');
+    if (items.empty() || items.size() > MAX_RANGES) {
+        return false;
+    }
     
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::string item = Utils::trim(items[i]);
+        size_t dash = item.find('-');
+        if (dash == std::string::npos) {
+            return false;
+        }
+        std::string firstStr = Utils::trim(item.substr(0, dash));
+        std::string lastStr = Utils::trim(item.substr(dash + 1));
+        if ((firstStr.empty() && lastStr.empty()) ||
+            firstStr.find_first_not_of("0123456789") != std::string::npos ||
+            lastStr.find_first_not_of("0123456789") != std::string::npos ||
+            firstStr.length() > 19 || lastStr.length() > 19) {
+            return false;
+        }
+        
+        size_t first;
+        size_t last;
+        if (firstStr.empty()) {
+            // Suffix range: the final N bytes
+            unsigned long long suffix = strtoull(lastStr.c_str(), NULL, 10);
+            if (suffix == 0 || fileSize == 0) {
+                continue;
+            }
+            first = (suffix >= fileSize) ? 0 : fileSize - static_cast<size_t>(suffix);
+            last = fileSize - 1;
+        } else {
+            unsigned long long start = strtoull(firstStr.c_str(), NULL, 10);
+            if (!lastStr.empty() && strtoull(lastStr.c_str(), NULL, 10) < start) {
+                return false;
+            }
+            if (start >= fileSize) {
+                continue; // Unsatisfiable on its own, the others may still apply
+            }
+            first = static_cast<size_t>(start);
+            last = fileSize - 1;
+            if (!lastStr.empty()) {
+                unsigned long long end = strtoull(lastStr.c_str(), NULL, 10);
+                if (end < last) {
+                    last = static_cast<size_t>(end);
+                }
+            }
+        }
+        ranges.push_back(std::make_pair(first, last));
+    }
+    return true;
+}
+
+void HttpResponse::adoptBody(std::string& body) {
+    _bodyFile.reset();
+    _bodyFileParts.clear();
+    _sharedBody.reset();
+    _body.clear();
+    _body.swap(body);
+    setContentLength(_body.length());
+}
+
+void HttpResponse::setCompressible(bool compressible) {
+    _compressible = compressible;
+}
+
+bool HttpResponse::isCompressible() const {
+    return _compressible;
+}
+
+void HttpResponse::dropBody() {
+    _body.clear();
+    _bodyFile.reset();
+    _bodyFileParts.clear();
+    _sharedBody.reset();
+}
+
+std::string HttpResponse::toString() const {
+    std::string response;
+    serializeHeaders(response);
+    response.append(_sharedBody.data(), _sharedBody.size());
+    response.append(_body);
+    return response;
+}
+
+std::string HttpResponse::serializeHeaders() const {
+    std::string response;
+    serializeHeaders(response);
     return response;
 }
 
+void HttpResponse::serializeHeaders(std::string& out) const {
+    char status[16];
+    int statusLength = snprintf(status, sizeof(status), " %d ", _statusCode);
+
+    // Size the buffer once, then write the status line and fields straight into it
+    out.reserve(out.length() + _version.length() + statusLength + _statusMessage.length() + 2 +
+                _headers.serializedLength() + 2);
+    out.append(_version);
+    out.append(status, statusLength);
+    out.append(_statusMessage);
+    out.append("\r\n", 2);
+    _headers.serialize(out);
+    out.append("\r\n", 2); // Empty line separating headers from body
+}
+
 void HttpResponse::clear() {
     _statusCode = 200;
     _statusMessage = "OK";
     _headers.clear();
     _body.clear();
+    _bodyFile.reset();
+    _bodyFileParts.clear();
+    _sharedBody.reset();
+    _compressible = false;
     _version = "HTTP/1.1";
     
-    setHeader("Server", "webserv/1.0");
-    setHeader("Date", Utils::getCurrentTime());
+    _headers.set(HeaderTable::HEADER_SERVER, "webserv/1.0");
+    _headers.set(HeaderTable::HEADER_DATE, Clock::httpDate());
 }
 
 HttpResponse HttpResponse::createErrorResponse(int statusCode) {
@@ -130,26 +404,52 @@ HttpResponse HttpResponse::createErrorResponse(int statusCode) {
 }
 
 HttpResponse HttpResponse::createFileResponse(const std::string& filePath) {
-    HttpResponse response;
-    
-    if (!Utils::fileExists(filePath)) {
-        return createErrorResponse(404);
+    // The body is sent straight from the descriptor, never read into memory
+    FileHandle file;
+    if (!file.open(filePath)) {
+        return createErrorResponse(errno == EACCES ? 403 : 404);
     }
+    return createFileResponse(file);
+}
+
+HttpResponse HttpResponse::createFileResponse(const FileHandle& file) {
+    HttpResponse response;
     
-    std::string content = Utils::readFile(filePath);
-    
-    std::string mimeType = getMimeType(filePath);
+    std::string mimeType = getMimeType(file.path());
     response.setContentType(mimeType);
-    response.setBody(content);
+    response.setHeader("Accept-Ranges", "bytes");
+    response.setHeader("Last-Modified", Utils::formatHttpDate(file.mtime()));
+    response.setHeader("ETag", makeETag(file));
+    response.setBodyFile(file, 0, file.size());
     
     return response;
 }
 
+std::string HttpResponse::makeETag(const FileHandle& file) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "\"%lx-%lx-%lx\"", static_cast<unsigned long>(file.inode()),
+             static_cast<unsigned long>(file.size()), static_cast<unsigned long>(file.mtime()));
+    return buffer;
+}
+
+std::string HttpResponse::makeWeakETag(const std::string& content) {
+    // FNV-1a over the body; weak because the same listing may be rendered differently
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < content.length(); ++i) {
+        hash ^= static_cast<unsigned char>(content[i]);
+        hash *= 1099511628211ULL;
+    }
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "W/\"%lx-%llx\"", static_cast<unsigned long>(content.length()), hash);
+    return buffer;
+}
+
 std::string HttpResponse::getStatusMessage(int code) {
     switch (code) {
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
+        case 206: return "Partial Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
         case 304: return "Not Modified";
@@ -161,6 +461,7 @@ std::string HttpResponse::getStatusMessage(int code) {
         case 408: return "Request Timeout";
         case 413: return "Payload Too Large";
         case 414: return "URI Too Long";
+        case 416: return "Range Not Satisfiable";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 502: return "Bad Gateway";
@@ -0,0 +1,247 @@
+#include "../include/MultipartParser.hpp"
+#include "../include/Utils.hpp"
+#include <strings.h>
+
+namespace {
+    bool isBlank(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    // A parameter value: a quoted-string (backslash escapes undone) or a bare token
+    std::string parameterValue(const std::string& text, size_t& pos) {
+        std::string value;
+        if (pos < text.size() && text[pos] == '"') {
+            for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+                if (text[pos] == '\\' && pos + 1 < text.size()) {
+                    ++pos;
+                }
+                value += text[pos];
+            }
+            return value;
+        }
+        size_t end = text.find(';', pos);
+        value = Utils::trim(text.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+        pos = end;
+        return value;
+    }
+}
+
+MultipartParser::MultipartParser(const std::string& boundary)
+    : _state(STATE_PREAMBLE), _delimiter("\r\n--" + boundary), _atBodyStart(true), _headerBytes(0) {
+    // RFC 2046 5.1.1: 1 to 70 characters
+    if (boundary.empty() || boundary.size() > 70) {
+        _state = STATE_MALFORMED;
+    }
+
+    const size_t length = _delimiter.size();
+    for (size_t c = 0; c < 256; ++c) {
+        _skip[c] = length;
+    }
+    for (size_t i = 0; i + 1 < length; ++i) {
+        _skip[static_cast<unsigned char>(_delimiter[i])] = length - 1 - i;
+    }
+}
+
+MultipartParser::Event MultipartParser::parse(const char* data, size_t length, size_t& consumed) {
+    consumed = 0;
+    while (true) {
+        const char* rest = data + consumed;
+        const size_t available = length - consumed;
+
+        switch (_state) {
+            case STATE_PREAMBLE: {
+                // The body normally opens with the first delimiter, minus its CRLF; only
+                // there may it lack one, so the check stops once any preamble is seen
+                if (_atBodyStart) {
+                    const char* opening = _delimiter.data() + 2;
+                    const size_t openingLength = _delimiter.size() - 2;
+                    if (memcmp(rest, opening, std::min(available, openingLength)) == 0) {
+                        if (available < openingLength) {
+                            return EVENT_NEED_MORE;
+                        }
+                        consumed += openingLength;
+                        _state = STATE_AFTER_DELIMITER;
+                        break;
+                    }
+                    _atBodyStart = false;
+                }
+                size_t pos = findDelimiter(rest, available);
+                if (pos == std::string::npos) {
+                    consumed += available - heldBack(rest, available); // Preamble is dropped
+                    return EVENT_NEED_MORE;
+                }
+                consumed += pos + _delimiter.size();
+                _state = STATE_AFTER_DELIMITER;
+                break;
+            }
+
+            case STATE_AFTER_DELIMITER: {
+                if (available < 2) {
+                    return EVENT_NEED_MORE;
+                }
+                if (rest[0] == '-' && rest[1] == '-') {
+                    consumed += 2;
+                    _state = STATE_DONE;
+                    return EVENT_DONE;
+                }
+                size_t pos = 0;
+                while (pos < available && pos < MAX_PADDING && isBlank(rest[pos])) {
+                    ++pos;
+                }
+                if (pos < available && rest[pos] == '\r') {
+                    ++pos;
+                }
+                if (pos == available) {
+                    return EVENT_NEED_MORE;
+                }
+                if (rest[pos] != '\n') {
+                    return fail();
+                }
+                consumed += pos + 1;
+                _state = STATE_HEADERS;
+                _headerBytes = 0;
+                _name.clear();
+                _filename.clear();
+                break;
+            }
+
+            case STATE_HEADERS: {
+                const char* lf = static_cast<const char*>(memchr(rest, '\n', available));
+                if (!lf) {
+                    return (_headerBytes + available > MAX_HEADER_BYTES) ? fail() : EVENT_NEED_MORE;
+                }
+                size_t lineLength = static_cast<size_t>(lf - rest);
+                _headerBytes += lineLength + 1;
+                if (_headerBytes > MAX_HEADER_BYTES) {
+                    return fail();
+                }
+                consumed += lineLength + 1;
+                if (lineLength > 0 && rest[lineLength - 1] == '\r') {
+                    --lineLength;
+                }
+                if (lineLength == 0) {
+                    _state = STATE_BODY;
+                    return EVENT_PART_BEGIN;
+                }
+                parseHeaderLine(rest, lineLength);
+                break;
+            }
+
+            case STATE_BODY: {
+                // Only entered at the start of a call, so the content starts at data[0]
+                size_t pos = findDelimiter(rest, available);
+                if (pos == 0) {
+                    consumed += _delimiter.size();
+                    _state = STATE_AFTER_DELIMITER;
+                    return EVENT_PART_END;
+                }
+                if (pos == std::string::npos) {
+                    pos = available - heldBack(rest, available);
+                    if (pos == 0) {
+                        return EVENT_NEED_MORE;
+                    }
+                }
+                consumed += pos;
+                return EVENT_PART_DATA;
+            }
+
+            case STATE_DONE:
+                return EVENT_DONE;
+
+            default:
+                return EVENT_MALFORMED;
+        }
+    }
+}
+
+const std::string& MultipartParser::name() const {
+    return _name;
+}
+
+const std::string& MultipartParser::filename() const {
+    return _filename;
+}
+
+std::string MultipartParser::boundaryFrom(const std::string& contentType) {
+    size_t pos = Utils::toLower(contentType).find("boundary=");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += 9; // length of "boundary="
+    return parameterValue(contentType, pos);
+}
+
+MultipartParser::Event MultipartParser::fail() {
+    _state = STATE_MALFORMED;
+    return EVENT_MALFORMED;
+}
+
+// Boyer-Moore-Horspool: compares the last byte of each candidate position first
+// and skips ahead by how far that byte sits from the end of the delimiter, so a
+// long boundary is passed over several bytes at a time through part content
+size_t MultipartParser::findDelimiter(const char* data, size_t length) const {
+    const size_t delimiterLength = _delimiter.size();
+    const char* delimiter = _delimiter.data();
+    const char last = delimiter[delimiterLength - 1];
+
+    for (size_t pos = 0; pos + delimiterLength <= length; ) {
+        char c = data[pos + delimiterLength - 1];
+        if (c == last && memcmp(data + pos, delimiter, delimiterLength - 1) == 0) {
+            return pos;
+        }
+        pos += _skip[static_cast<unsigned char>(c)];
+    }
+    return std::string::npos;
+}
+
+// Length of the tail of data that could be the start of a delimiter cut off by the
+// end of the window. Boundaries cannot contain CR, so only a CR can begin one.
+size_t MultipartParser::heldBack(const char* data, size_t length) const {
+    size_t from = (length >= _delimiter.size()) ? length - _delimiter.size() + 1 : 0;
+    for (size_t i = from; i < length; ++i) {
+        if (data[i] == '\r' && memcmp(data + i, _delimiter.data(), length - i) == 0) {
+            return length - i;
+        }
+    }
+    return 0;
+}
+
+// Only Content-Disposition matters here; other part headers and lines without a colon are ignored
+void MultipartParser::parseHeaderLine(const char* line, size_t length) {
+    const char* colon = static_cast<const char*>(memchr(line, ':', length));
+    if (!colon) {
+        return;
+    }
+    size_t nameLength = static_cast<size_t>(colon - line);
+    while (nameLength > 0 && isBlank(line[nameLength - 1])) {
+        --nameLength;
+    }
+    if (nameLength != 19 || strncasecmp(line, "Content-Disposition", 19) != 0) {
+        return;
+    }
+
+    // form-data; name="field"; filename="file.txt"
+    std::string value(colon + 1, line + length);
+    size_t pos = value.find(';');
+    while (pos != std::string::npos) {
+        ++pos;
+        size_t equals = value.find('=', pos);
+        if (equals == std::string::npos) {
+            break;
+        }
+        std::string key = Utils::toLower(Utils::trim(value.substr(pos, equals - pos)));
+        pos = equals + 1;
+        while (pos < value.size() && isBlank(value[pos])) {
+            ++pos;
+        }
+        std::string parameter = parameterValue(value, pos);
+        if (key == "name") {
+            _name = parameter;
+        } else if (key == "filename") {
+            _filename = parameter;
+        }
+        if (pos != std::string::npos) {
+            pos = value.find(';', pos);
+        }
+    }
+}
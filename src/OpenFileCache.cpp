@@ -0,0 +1,111 @@
+#include "../include/OpenFileCache.hpp"
+
+OpenFileCache::OpenFileCache() : _maxEntries(0), _validMs(0), _cacheErrors(true), _hits(0), _misses(0) {
+}
+
+void OpenFileCache::configure(size_t maxEntries, int validSeconds, bool cacheErrors) {
+    _maxEntries = maxEntries;
+    _validMs = static_cast<uint64_t>(validSeconds) * 1000;
+    _cacheErrors = cacheErrors;
+}
+
+OpenFileCache::Lookup OpenFileCache::lookup(const std::string& path, uint64_t now) {
+    if (_maxEntries == 0) {
+        return resolve(path);
+    }
+
+    std::map<std::string, Entry>::iterator it = _entries.find(path);
+    if (it != _entries.end()) {
+        Entry& entry = it->second;
+        bool fresh = now - entry.validatedAt < _validMs;
+        if (fresh || stillCurrent(path, entry.result)) {
+            if (!fresh) {
+                entry.validatedAt = now;
+            }
+            _lru.splice(_lru.begin(), _lru, entry.lru);
+            ++_hits;
+            return entry.result;
+        }
+        erase(it);
+    }
+
+    ++_misses;
+    Lookup result = resolve(path);
+    if (!_cacheErrors && (result.kind == KIND_MISSING || result.kind == KIND_ERROR)) {
+        return result;
+    }
+
+    while (_entries.size() >= _maxEntries && !_lru.empty()) {
+        erase(_entries.find(_lru.back()));
+    }
+    _lru.push_front(path);
+    Entry& entry = _entries[path];
+    entry.result = result;
+    entry.validatedAt = now;
+    entry.lru = _lru.begin();
+    return result;
+}
+
+void OpenFileCache::invalidate(const std::string& path) {
+    std::map<std::string, Entry>::iterator it = _entries.find(path);
+    if (it != _entries.end()) {
+        erase(it);
+    }
+}
+
+void OpenFileCache::clear() {
+    _entries.clear();
+    _lru.clear();
+}
+
+unsigned long OpenFileCache::hits() const {
+    return _hits;
+}
+
+unsigned long OpenFileCache::misses() const {
+    return _misses;
+}
+
+OpenFileCache::Lookup OpenFileCache::resolve(const std::string& path) {
+    Lookup result;
+    result.error = 0;
+    if (result.file.open(path)) {
+        result.kind = KIND_FILE;
+        return result;
+    }
+
+    result.error = errno;
+    if (errno == EISDIR) {
+        result.kind = KIND_DIRECTORY;
+    } else if (errno == ENOENT || errno == ENOTDIR || errno == ENAMETOOLONG) {
+        result.kind = KIND_MISSING;
+    } else {
+        // An unreadable directory is still a directory (listing it will fail later)
+        struct stat st;
+        result.kind = (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) ? KIND_DIRECTORY : KIND_ERROR;
+    }
+    return result;
+}
+
+// Once the validity window has passed, one stat() tells whether the path still
+// refers to the same object in the same state
+bool OpenFileCache::stillCurrent(const std::string& path, const Lookup& result) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return result.kind == KIND_MISSING && (errno == ENOENT || errno == ENOTDIR);
+    }
+    switch (result.kind) {
+        case KIND_FILE:
+            return S_ISREG(st.st_mode) && st.st_ino == result.file.inode() && st.st_dev == result.file.device() &&
+                   st.st_mtime == result.file.mtime() && static_cast<size_t>(st.st_size) == result.file.size();
+        case KIND_DIRECTORY:
+            return S_ISDIR(st.st_mode);
+        default:
+            return false; // The path exists now, or its permissions may have changed
+    }
+}
+
+void OpenFileCache::erase(std::map<std::string, Entry>::iterator it) {
+    _lru.erase(it->second.lru);
+    _entries.erase(it);
+}
@@ -0,0 +1,177 @@
+#include "../include/OutputQueue.hpp"
+
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
+
+#ifndef MSG_MORE
+# define MSG_MORE 0
+#endif
+
+OutputQueue::OutputQueue() : _frontOffset(0), _bytes(0), _memoryBytes(0) {
+}
+
+void OutputQueue::append(const std::string& data) {
+    std::string copy(data);
+    appendSwap(copy);
+}
+
+void OutputQueue::appendSwap(std::string& data) {
+    if (data.empty()) {
+        return;
+    }
+    _segments.push_back(Segment());
+    Segment& segment = _segments.back();
+    segment.offset = 0;
+    segment.length = data.length();
+    segment.data.swap(data);
+    _bytes += segment.length;
+    _memoryBytes += segment.length;
+}
+
+void OutputQueue::appendShared(const SharedBuffer& buffer) {
+    if (buffer.empty()) {
+        return;
+    }
+    _segments.push_back(Segment());
+    Segment& segment = _segments.back();
+    segment.shared = buffer;
+    segment.offset = 0;
+    segment.length = buffer.size();
+    _bytes += segment.length;
+}
+
+void OutputQueue::appendFile(const FileHandle& file, off_t offset, size_t length) {
+    if (length == 0 || !file.isOpen()) {
+        return;
+    }
+    _segments.push_back(Segment());
+    Segment& segment = _segments.back();
+    segment.file = file;
+    segment.offset = offset;
+    segment.length = length;
+    _bytes += length;
+}
+
+bool OutputQueue::empty() const {
+    return _bytes == 0;
+}
+
+size_t OutputQueue::size() const {
+    return _bytes;
+}
+
+size_t OutputQueue::memorySize() const {
+    return _memoryBytes;
+}
+
+void OutputQueue::clear() {
+    _segments.clear();
+    _frontOffset = 0;
+    _bytes = 0;
+    _memoryBytes = 0;
+}
+
+ssize_t OutputQueue::flush(int socketFd) {
+    ssize_t total = 0;
+    while (!_segments.empty() && total < FLUSH_BUDGET) {
+        size_t requested = 0;
+        ssize_t written = _segments.front().file.isOpen() ? flushFile(socketFd, requested)
+                                                          : flushMemory(socketFd, requested);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            return -1;
+        }
+        total += written;
+        if (static_cast<size_t>(written) < requested) {
+            break; // Socket buffer is full
+        }
+    }
+    return total;
+}
+
+ssize_t OutputQueue::flushMemory(int socketFd, size_t& requested) {
+    struct iovec iov[MAX_IOV];
+    int count = 0;
+    bool fileFollows = false;
+    for (std::deque<Segment>::const_iterator it = _segments.begin(); it != _segments.end() && count < MAX_IOV; ++it) {
+        if (it->file.isOpen()) {
+            fileFollows = true;
+            break;
+        }
+        size_t skip = (count == 0) ? _frontOffset : 0;
+        const char* bytes = it->shared.empty() ? it->data.data() : it->shared.data();
+        iov[count].iov_base = const_cast<char*>(bytes) + skip;
+        iov[count].iov_len = it->length - skip;
+        requested += iov[count].iov_len;
+        ++count;
+    }
+
+    // Cork the header block so it leaves in the same packet as the start of the file
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t written = sendmsg(socketFd, &msg, fileFollows ? MSG_MORE : 0);
+    if (written <= 0) {
+        return written;
+    }
+
+    // Advance the cursor past everything the kernel took
+    size_t remaining = static_cast<size_t>(written);
+    _bytes -= remaining;
+    while (remaining > 0) {
+        const Segment& front = _segments.front();
+        size_t taken = std::min(remaining, front.length - _frontOffset);
+        if (front.shared.empty()) {
+            _memoryBytes -= taken;
+        }
+        remaining -= taken;
+        if (_frontOffset + taken < front.length) {
+            _frontOffset += taken;
+            break;
+        }
+        _segments.pop_front();
+        _frontOffset = 0;
+    }
+    return written;
+}
+
+ssize_t OutputQueue::flushFile(int socketFd, size_t& requested) {
+    Segment& segment = _segments.front();
+    requested = std::min(segment.length, static_cast<size_t>(FILE_CHUNK));
+
+#ifdef __linux__
+    off_t offset = segment.offset;
+    ssize_t written = sendfile(socketFd, segment.file.fd(), &offset, requested);
+    if (written == 0) {
+        // File shrank underneath us; the response can no longer be framed
+        errno = EIO;
+        return -1;
+    }
+#else
+    char buffer[65536];
+    requested = std::min(requested, sizeof(buffer));
+    ssize_t bytesRead = pread(segment.file.fd(), buffer, requested, segment.offset);
+    if (bytesRead <= 0) {
+        errno = EIO;
+        return -1;
+    }
+    requested = static_cast<size_t>(bytesRead);
+    ssize_t written = send(socketFd, buffer, bytesRead, 0);
+#endif
+    if (written <= 0) {
+        return written;
+    }
+
+    segment.offset += written;
+    segment.length -= written;
+    _bytes -= written;
+    if (segment.length == 0) {
+        _segments.pop_front();
+        _frontOffset = 0;
+    }
+    return written;
+}
@@ -0,0 +1,302 @@
+#include "../include/RequestBody.hpp"
+#include "../include/Utils.hpp"
+#include "../include/AtomicFile.hpp"
+#include <sys/mman.h>
+
+namespace {
+    // Per-thread free list of retired bodies, so small bodies reuse a warm buffer
+    __thread void* freeList = NULL;
+    __thread size_t freeCount = 0;
+#ifdef __linux__
+    // Per-thread pipe that spliced body bytes pass through; always left empty
+    __thread int splicePipe[2] = { -1, -1 };
+#endif
+
+    const char* const SPOOL_DIRECTORY = "/tmp";
+
+    // An unnamed file for a spilled body: O_TMPFILE in `directory` (the volume the
+    // body is headed for) or else /tmp, where the filesystem supports it, then a
+    // memfd, then a file unlinked as soon as it is created
+    int openSpool(const std::string& directory, bool& linkable) {
+        linkable = false;
+        int fd;
+#ifdef O_TMPFILE
+        const char* candidates[] = { directory.c_str(), SPOOL_DIRECTORY };
+        for (size_t i = 0; i < 2; ++i) {
+            if (!*candidates[i]) {
+                continue;
+            }
+            // 0644 is the mode an upload keeps if the spool is linked into place
+            fd = open(candidates[i], O_TMPFILE | O_RDWR | O_CLOEXEC, 0644);
+            if (fd >= 0) {
+                linkable = true;
+                return fd;
+            }
+        }
+#endif
+#ifdef MFD_CLOEXEC
+        fd = memfd_create("webserv_body", MFD_CLOEXEC);
+        if (fd >= 0) {
+            return fd;
+        }
+#endif
+        static int counter = 0;
+        std::ostringstream oss;
+        // Shared by all worker threads, so bump the counter atomically
+        oss << SPOOL_DIRECTORY << "/webserv_body_" << getpid() << "_" << __sync_add_and_fetch(&counter, 1);
+        fd = open(oss.str().c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            unlink(oss.str().c_str());
+        }
+        return fd;
+    }
+}
+
+RequestBody::RequestBody() : _shared(NULL) {
+}
+
+RequestBody::RequestBody(const RequestBody& other) : _shared(other._shared) {
+    if (_shared) {
+        ++_shared->refs;
+    }
+}
+
+RequestBody& RequestBody::operator=(const RequestBody& other) {
+    if (_shared != other._shared) {
+        release();
+        _shared = other._shared;
+        if (_shared) {
+            ++_shared->refs;
+        }
+    }
+    return *this;
+}
+
+RequestBody::~RequestBody() {
+    release();
+}
+
+void RequestBody::begin(size_t memoryLimit, const std::string& spoolDirectory) {
+    release();
+    _shared = acquire();
+    _shared->memoryLimit = memoryLimit;
+    _shared->spoolDirectory = spoolDirectory;
+}
+
+bool RequestBody::append(const char* data, size_t length) {
+    if (!_shared) {
+        return false;
+    }
+    if (_shared->fd < 0 && _shared->size + length > _shared->memoryLimit && !spool()) {
+        return false;
+    }
+
+    if (_shared->fd >= 0) {
+        if (!Utils::writeAll(_shared->fd, data, length)) {
+            Utils::logError("Failed to write request body spool file: " + std::string(strerror(errno)));
+            return false;
+        }
+    } else {
+        _shared->memory.append(data, length);
+    }
+    _shared->size += length;
+    return true;
+}
+
+ssize_t RequestBody::spliceFrom(int socketFd, size_t length) {
+#ifdef __linux__
+    if (!_shared || _shared->fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (splicePipe[0] < 0) {
+        if (pipe2(splicePipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            splicePipe[0] = -1;
+            errno = EINVAL; // Read the body the ordinary way instead
+            return -1;
+        }
+        fcntl(splicePipe[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE); // Best effort; 64k otherwise
+    }
+
+    ssize_t moved = splice(socketFd, NULL, splicePipe[1], NULL, std::min(length, static_cast<size_t>(SPLICE_PIPE_SIZE)),
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (moved <= 0) {
+        return moved;
+    }
+
+    // A regular file (or memfd) takes everything; only an error leaves bytes behind
+    for (size_t pending = static_cast<size_t>(moved); pending > 0; ) {
+        ssize_t written = splice(splicePipe[0], NULL, _shared->fd, NULL, pending, SPLICE_F_MOVE);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            int error = (written < 0) ? errno : EIO;
+            Utils::logError("Failed to splice request body into spool file: " + std::string(strerror(error)));
+            // The stranded bytes make the pipe useless; the next call opens a fresh one
+            close(splicePipe[0]);
+            close(splicePipe[1]);
+            splicePipe[0] = splicePipe[1] = -1;
+            errno = EIO;
+            return -1;
+        }
+        pending -= static_cast<size_t>(written);
+    }
+    _shared->size += static_cast<size_t>(moved);
+    return moved;
+#else
+    (void)socketFd;
+    (void)length;
+    errno = EINVAL; // No splice(): the client reads and appends instead
+    return -1;
+#endif
+}
+
+void RequestBody::reset() {
+    release();
+}
+
+bool RequestBody::isOpen() const {
+    return _shared != NULL;
+}
+
+bool RequestBody::inMemory() const {
+    return _shared && _shared->fd < 0;
+}
+
+size_t RequestBody::size() const {
+    return _shared ? _shared->size : 0;
+}
+
+int RequestBody::spoolFd() const {
+    return _shared ? _shared->fd : -1;
+}
+
+ssize_t RequestBody::read(size_t offset, char* buffer, size_t length) const {
+    if (!_shared || offset >= _shared->size) {
+        return 0;
+    }
+    length = std::min(length, _shared->size - offset);
+    if (_shared->fd < 0) {
+        memcpy(buffer, _shared->memory.data() + offset, length);
+        return static_cast<ssize_t>(length);
+    }
+
+    ssize_t bytesRead;
+    do {
+        bytesRead = pread(_shared->fd, buffer, length, static_cast<off_t>(offset));
+    } while (bytesRead < 0 && errno == EINTR);
+    return bytesRead;
+}
+
+bool RequestBody::readAll(std::string& out) const {
+    out.clear();
+    if (!_shared) {
+        return true;
+    }
+    if (_shared->fd < 0) {
+        out = _shared->memory;
+        return true;
+    }
+
+    out.resize(_shared->size);
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t bytesRead = read(done, &out[done], out.size() - done);
+        if (bytesRead <= 0) {
+            out.clear();
+            return false;
+        }
+        done += static_cast<size_t>(bytesRead);
+    }
+    return true;
+}
+
+bool RequestBody::saveTo(const std::string& destPath) const {
+    // On the destination's filesystem the spool itself becomes the file: nothing is copied
+    if (_shared && _shared->linkable && AtomicFile::linkInto(_shared->fd, destPath)) {
+        return true;
+    }
+
+    AtomicFile file;
+    if (!file.open(destPath)) {
+        return false;
+    }
+    bool ok = true;
+    if (inMemory()) {
+        ok = file.write(_shared->memory.data(), _shared->memory.length());
+    } else if (_shared) {
+        ok = file.copyFrom(_shared->fd, _shared->size);
+    }
+    if (!ok) {
+        Utils::logError("Failed to write request body to " + destPath + ": " + strerror(errno));
+        return false;
+    }
+    return file.commit();
+}
+
+void RequestBody::release() {
+    if (_shared && --_shared->refs == 0) {
+        recycle(_shared);
+    }
+    _shared = NULL;
+}
+
+// Moves what is buffered so far into a new spool file; later appends go straight there
+bool RequestBody::spool() {
+    if (!_shared) {
+        return false;
+    }
+    if (_shared->fd >= 0) {
+        return true;
+    }
+    bool linkable;
+    int fd = openSpool(_shared->spoolDirectory, linkable);
+    if (fd < 0) {
+        Utils::logError("Failed to create request body spool file: " + std::string(strerror(errno)));
+        return false;
+    }
+    if (!Utils::writeAll(fd, _shared->memory.data(), _shared->memory.length())) {
+        Utils::logError("Failed to write request body spool file: " + std::string(strerror(errno)));
+        close(fd);
+        return false;
+    }
+
+    _shared->fd = fd;
+    _shared->linkable = linkable;
+    _shared->memory.clear();
+    Utils::logInfo(std::string("Streaming request body to ") + (linkable ? "an O_TMPFILE" : "an anonymous") + " spool file");
+    return true;
+}
+
+RequestBody::Shared* RequestBody::acquire() {
+    Shared* shared = static_cast<Shared*>(freeList);
+    if (shared) {
+        freeList = shared->nextFree;
+        --freeCount;
+    } else {
+        shared = new Shared;
+    }
+    shared->fd = -1;
+    shared->linkable = false;
+    shared->size = 0;
+    shared->memoryLimit = 0;
+    shared->refs = 1;
+    shared->nextFree = NULL;
+    return shared;
+}
+
+void RequestBody::recycle(Shared* shared) {
+    if (shared->fd >= 0) {
+        close(shared->fd); // Unnamed, so this frees it unless it was linked somewhere
+    }
+
+    if (freeCount >= POOL_MAX_BUFFERS || shared->memory.capacity() > POOL_MAX_CAPACITY) {
+        delete shared;
+        return;
+    }
+    shared->memory.clear(); // Keeps its capacity for the next body
+    shared->nextFree = static_cast<Shared*>(freeList);
+    freeList = shared;
+    ++freeCount;
+}
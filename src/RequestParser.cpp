@@ -0,0 +1,157 @@
+#include "../include/RequestParser.hpp"
+#include "../include/ByteScanner.hpp"
+
+namespace {
+    bool isBlank(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    RequestParser::Slice makeSlice(size_t start, size_t end) {
+        RequestParser::Slice slice;
+        slice.offset = start;
+        slice.length = end - start;
+        return slice;
+    }
+}
+
+RequestParser::RequestParser() {
+    reset();
+}
+
+bool RequestParser::parse(const char* data, size_t length) {
+    while (_phase != PHASE_DONE && _scanned < length) {
+        size_t lineEnd = _scanned + ByteScanner::findLineEnd(data + _scanned, length - _scanned);
+        if (lineEnd == length) {
+            _scanned = length; // Only the new bytes get searched next time
+            return false;
+        }
+
+        size_t next = lineEnd + 1;
+        if (lineEnd > _lineStart && data[lineEnd - 1] == '\r') {
+            --lineEnd; // CRLF, or a bare LF as tolerated by RFC 9112 2.2
+        }
+
+        if (_phase == PHASE_REQUEST_LINE) {
+            parseRequestLine(data, _lineStart, lineEnd);
+        } else if (lineEnd == _lineStart) {
+            _phase = PHASE_DONE; // The blank line ending the header block
+        } else {
+            parseField(data, _lineStart, lineEnd);
+        }
+        _lineStart = next;
+        _scanned = next;
+    }
+    return _phase == PHASE_DONE;
+}
+
+void RequestParser::reset() {
+    _phase = PHASE_REQUEST_LINE;
+    _lineStart = 0;
+    _scanned = 0;
+    _method = makeSlice(0, 0);
+    _uri = makeSlice(0, 0);
+    _version = makeSlice(0, 0);
+    _fields.clear();
+}
+
+bool RequestParser::started() const {
+    return _scanned > 0;
+}
+
+bool RequestParser::isComplete() const {
+    return _phase == PHASE_DONE;
+}
+
+size_t RequestParser::headerLength() const {
+    return _lineStart;
+}
+
+const RequestParser::Slice& RequestParser::method() const {
+    return _method;
+}
+
+const RequestParser::Slice& RequestParser::uri() const {
+    return _uri;
+}
+
+const RequestParser::Slice& RequestParser::version() const {
+    return _version;
+}
+
+size_t RequestParser::fieldCount() const {
+    return _fields.size();
+}
+
+const RequestParser::Field& RequestParser::field(size_t index) const {
+    return _fields[index];
+}
+
+std::string RequestParser::text(const char* data, const Slice& slice) {
+    return std::string(data + slice.offset, slice.length);
+}
+
+// "METHOD SP request-target SP HTTP-version"; runs of blanks count as one separator
+void RequestParser::parseRequestLine(const char* data, size_t start, size_t end) {
+    Slice parts[3];
+    size_t count = 0;
+    size_t pos = start;
+
+    while (count < 3) {
+        while (pos < end && isBlank(data[pos])) {
+            ++pos;
+        }
+        if (pos == end) {
+            break;
+        }
+        size_t tokenStart = pos;
+        while (pos < end && !isBlank(data[pos])) {
+            ++pos;
+        }
+        parts[count++] = makeSlice(tokenStart, pos);
+    }
+
+    if (count == 0) {
+        return; // Empty lines before the request line are skipped (RFC 9112 2.2)
+    }
+    if (count == 3) {
+        _method = parts[0];
+        _uri = parts[1];
+        _version = parts[2];
+    }
+    _phase = PHASE_FIELDS;
+}
+
+// "name: value"; lines without a colon are ignored
+void RequestParser::parseField(const char* data, size_t start, size_t end) {
+    // A well-formed name is a token running straight up to the colon; anything else
+    // (whitespace before the colon, stray bytes) takes the tolerant path
+    size_t nameEnd = start + ByteScanner::skipToken(data + start, end - start);
+    if (nameEnd == end || data[nameEnd] != ':') {
+        const char* colon = static_cast<const char*>(memchr(data + start, ':', end - start));
+        if (!colon) {
+            return;
+        }
+        nameEnd = static_cast<size_t>(colon - data);
+    }
+    size_t valueStart = nameEnd + 1;
+    while (start < nameEnd && isBlank(data[start])) {
+        ++start;
+    }
+    while (nameEnd > start && isBlank(data[nameEnd - 1])) {
+        --nameEnd;
+    }
+    while (valueStart < end && isBlank(data[valueStart])) {
+        ++valueStart;
+    }
+    while (end > valueStart && isBlank(data[end - 1])) {
+        --end;
+    }
+    if (start == nameEnd) {
+        return;
+    }
+
+    Field field;
+    field.name = makeSlice(start, nameEnd);
+    field.value = makeSlice(valueStart, end);
+    _fields.push_back(field);
+}
@@ -1,17 +1,50 @@
 #include "../include/Server.hpp"
 #include "../include/Utils.hpp"
 #include "../include/CGI.hpp"
+#include "../include/ByteScanner.hpp"
+#include "../include/MultipartParser.hpp"
+#include "../include/AtomicFile.hpp"
+#include "../include/Clock.hpp"
 #include <fstream>
 #include <sstream>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <cstdio>
 
-Server::Server() : _running(false), _lastTimeoutCheck(time(NULL)) {
+// Pipes must not leak into CGI children forked concurrently by other worker threads
+static bool createCloexecPipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) == -1) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+static void closePipe(int fds[2]) {
+    if (fds[0] >= 0) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+Server::Server() : _running(false), _stopRequested(false), _draining(false), _drainDeadline(0),
+                   _now(TimerWheel::monotonicNow()) {
     _config = Config();
+    _defaultServerConfig = _config.getDefaultServer();
+    _wakePipe[0] = -1;
+    _wakePipe[1] = -1;
 }
 
-Server::Server(const Config& config) : _config(config), _running(false), _lastTimeoutCheck(time(NULL)) {
+Server::Server(const Config& config) : _config(config), _running(false), _stopRequested(false), _draining(false),
+                                       _drainDeadline(0), _now(TimerWheel::monotonicNow()) {
+    _defaultServerConfig = _config.getDefaultServer();
+    _wakePipe[0] = -1;
+    _wakePipe[1] = -1;
 }
 
 Server::~Server() {
@@ -19,6 +52,10 @@ Server::~Server() {
 }
 
 bool Server::initialize() {
+    return openListeners() && setupEventLoop();
+}
+
+bool Server::openListeners() {
     if (!createSockets()) {
         return false;
     }
@@ -31,14 +68,50 @@ bool Server::initialize() {
         return false;
     }
     
-    // Add all server sockets to poll list
+    return true;
+}
+
+bool Server::setupEventLoop() {
+    EventLoop::Engine engine = EventLoop::ENGINE_EPOLL;
+    EventLoop::parseEngine(_config.getGlobalConfig().eventEngine, engine);
+    if (!_eventLoop.open(engine)) {
+        Utils::logError("Failed to initialize event loop");
+        return false;
+    }
+    Utils::logInfo(std::string("Using ") + EventLoop::engineName(_eventLoop.getEngine()) + " event engine, " +
+                   ByteScanner::levelName(ByteScanner::level()) + " header scanning");
+    
+    // Register all server sockets with the event loop
     for (size_t i = 0; i < _servers.size(); ++i) {
-        struct pollfd serverPollFd;
-        serverPollFd.fd = _servers[i].socket;
-        serverPollFd.events = POLLIN;
-        _pollFds.push_back(serverPollFd);
+        if (!_eventLoop.add(_servers[i].socket, EventLoop::HANDLER_LISTENER, EventLoop::EVENT_READ)) {
+            return false;
+        }
+        _servers[i].resumeTimer = _timers.create(TimerWheel::TIMER_LISTENER, _servers[i].socket);
+        _servers[i].windowStart = _now;
+    }
+    
+    if (!createCloexecPipe(_wakePipe)) {
+        Utils::logError("Failed to create wakeup pipe: " + std::string(strerror(errno)));
+        return false;
     }
+    fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(_wakePipe[1], F_SETFL, fcntl(_wakePipe[1], F_GETFL, 0) | O_NONBLOCK);
+    _eventLoop.add(_wakePipe[0], EventLoop::HANDLER_WAKEUP, EventLoop::EVENT_READ);
     
+    const GlobalConfig& global = _config.getGlobalConfig();
+    _openFiles.configure(global.openFileCache, global.openFileCacheValid, global.openFileCacheErrors);
+    _fileCache.configure(global.fileCacheSize, global.fileCacheMaxFile, global.fileCacheValid);
+    if (_fileCache.isEnabled()) {
+        if (_fileCache.openWatcher()) {
+            _eventLoop.add(_fileCache.watchFd(), EventLoop::HANDLER_FILE_WATCH, EventLoop::EVENT_READ);
+        } else {
+            Utils::logInfo("inotify unavailable, file cache entries revalidate every " +
+                           Utils::intToString(global.fileCacheValid) + "s");
+        }
+        warmFileCache();
+    }
+    
+    _running = true;
     return true;
 }
 
@@ -64,6 +137,24 @@ bool Server::createSockets() {
             return false;
         }
         
+        // Let every worker thread bind its own listener; the kernel spreads accepts across them
+        if (_config.getGlobalConfig().workerThreads > 1 &&
+            setsockopt(serverInfo.socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+            Utils::logError("Failed to set SO_REUSEPORT for " + serverConfig.host + ":" + Utils::intToString(serverConfig.port));
+            close(serverInfo.socket);
+            return false;
+        }
+        
+        // Keep listeners out of CGI children
+        fcntl(serverInfo.socket, F_SETFD, FD_CLOEXEC);
+        
+#ifdef __linux__
+        // Inherited by every accepted socket, saving a setsockopt per connection
+        if (setsockopt(serverInfo.socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+            Utils::logError("Failed to set TCP_NODELAY (non-fatal): " + std::string(strerror(errno)));
+        }
+#endif
+        
         // Set non-blocking
         int flags = fcntl(serverInfo.socket, F_GETFL, 0);
         if (fcntl(serverInfo.socket, F_SETFL, flags | O_NONBLOCK) < 0) {
@@ -122,113 +213,251 @@ bool Server::listenSockets() {
 }
 
 void Server::run() {
-    _running = true;
+    std::vector<EventLoop::Event> events;
     
+    _now = TimerWheel::monotonicNow();
     while (_running) {
-        int pollResult = poll(&_pollFds[0], _pollFds.size(), 1000);
-        
-        if (pollResult < 0) {
-            if (errno == EINTR) {
-                // Interrupted by signal (e.g., Ctrl+C), exit gracefully
-                Utils::logInfo("Server interrupted by signal, shutting down...");
-                break;
+        if (_stopRequested && !_draining) {
+            beginDrain();
+        }
+        if (_draining && (isDrained() || _now >= _drainDeadline)) {
+            if (!isDrained()) {
+                Utils::logError("Shutdown timeout reached, dropping " + Utils::sizeToString(_clients.size()) +
+                                " connections and " + Utils::sizeToString(_cgiProcesses.size()) + " CGI processes");
             }
-            Utils::logError("Poll failed: " + std::string(strerror(errno)));
             break;
         }
         
-        if (pollResult == 0) continue;
+        // Sleep until the next timer is due (or indefinitely if none is armed), and
+        // never past the drain deadline
+        int timeout = _timers.nextTimeout(_now);
+        if (_draining) {
+            int left = static_cast<int>(_drainDeadline - _now);
+            timeout = (timeout < 0) ? left : std::min(timeout, left);
+        }
+        int pollResult = _eventLoop.wait(events, timeout);
+        _now = TimerWheel::monotonicNow();
+        Clock::update();
         
-        // Check server sockets for new connections
-        for (size_t i = 0; i < _servers.size(); ++i) {
-            if (i < _pollFds.size() && _pollFds[i].revents & POLLIN) {
-                acceptNewConnection(_servers[i].socket);
+        if (pollResult < 0) {
+            if (errno == EINTR) {
+                continue; // A stop signal has already called requestStop()
             }
+            Utils::logError("Poll failed: " + std::string(strerror(errno)));
+            break;
         }
         
-        // Check client sockets and CGI pipes
-        for (size_t i = _servers.size(); i < _pollFds.size(); ++i) {
-            int fd = _pollFds[i].fd;
+        for (size_t i = 0; i < events.size(); ++i) {
+            const EventLoop::Event& event = events[i];
             
-            if (_pollFds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
-                // Check if this is a CGI pipe
-                if (_cgiProcesses.find(fd) != _cgiProcesses.end()) {
-                    handleCgiCompletion(fd);
-                    --i;
-                    continue;
-                } else {
-                    Utils::logError("Socket error for fd " + Utils::intToString(fd));
-                    removeClient(fd);
-                    --i;
-                    continue;
-                }
+            // Skip events for fds that were closed (or reused) earlier in this batch
+            if (!_eventLoop.isCurrent(event)) {
+                continue;
             }
             
-            if (_pollFds[i].revents & POLLIN) {
-                // Check if this is a CGI pipe
-                if (_cgiProcesses.find(fd) != _cgiProcesses.end()) {
-                    handleCgiCompletion(fd);
-                } else {
-                    handleClientRead(fd);
+            switch (event.type) {
+                case EventLoop::HANDLER_LISTENER:
+                    if (event.events & EventLoop::EVENT_READ) {
+                        acceptNewConnection(event.fd);
+                    }
+                    break;
+                
+                case EventLoop::HANDLER_CLIENT:
+                    if (event.events & EventLoop::EVENT_ERROR) {
+                        Utils::logError("Socket error for fd " + Utils::intToString(event.fd));
+                        removeClient(event.fd);
+                        break;
+                    }
+                    if (event.events & EventLoop::EVENT_READ) {
+                        handleClientRead(event.fd);
+                    }
+                    if ((event.events & EventLoop::EVENT_WRITE) && _eventLoop.isCurrent(event)) {
+                        handleClientWrite(event.fd);
+                    }
+                    break;
+                
+                case EventLoop::HANDLER_CGI_OUTPUT:
+                    handleCgiCompletion(event.fd);
+                    break;
+                
+                case EventLoop::HANDLER_CGI_INPUT:
+                    if (event.events & EventLoop::EVENT_ERROR) {
+                        // The CGI closed its stdin early; stop feeding it
+                        closeCgiInput(event.fd);
+                    } else if (event.events & EventLoop::EVENT_WRITE) {
+                        handleCgiWrite(event.fd);
+                    }
+                    break;
+                
+                case EventLoop::HANDLER_WAKEUP: {
+                    char drain[64];
+                    while (read(event.fd, drain, sizeof(drain)) > 0) {
+                    }
+                    break;
                 }
-            }
-            
-            if (_pollFds[i].revents & POLLOUT) {
-				if (_cgiWritePipes.find(fd) != _cgiWritePipes.end()) {
-                    handleCgiWrite(fd); // New function
-                } else {
-                handleClientWrite(fd);
+                
+                case EventLoop::HANDLER_FILE_WATCH: {
+                    // Changes seen for the content cache retire cached descriptors too
+                    std::vector<std::string> changed;
+                    _fileCache.processWatchEvents(changed);
+                    for (size_t j = 0; j < changed.size(); ++j) {
+                        _openFiles.invalidate(changed[j]);
+                    }
+                    break;
                 }
+                
+                case EventLoop::HANDLER_NONE:
+                    break;
             }
-
-			// Periodically check for timeouts
-			time_t currentTime = time(NULL);
-			if (currentTime - _lastTimeoutCheck >= 5) { // Check every 5 seconds
-				checkClientTimeouts();
-				checkCgiTimeouts();
-				_lastTimeoutCheck = currentTime;
-			}
 		}
+		
+		resumePipelinedRequests();
+		processTimers();
 	}
 }
 
-bool Server::acceptNewConnection(int serverSocket) {
-    struct sockaddr_in clientAddr;
+// Graceful stop: no new connections, idle keep-alive connections are closed now,
+// and every other one once the response it is waiting for (static, CGI or
+// already queued) has been written, for up to shutdown_timeout seconds
+void Server::beginDrain() {
+    _draining = true;
+    _drainDeadline = _now + static_cast<uint64_t>(_config.getGlobalConfig().shutdownTimeout) * 1000;
+    closeListeners();
+    
+    std::vector<int> idle;
+    for (std::map<int, Client>::const_iterator it = _clients.begin(); it != _clients.end(); ++it) {
+        if (isIdle(it->second)) {
+            idle.push_back(it->first);
+        }
+    }
+    for (size_t i = 0; i < idle.size(); ++i) {
+        removeClient(idle[i]);
+    }
+    Utils::logInfo("Shutting down, finishing " + Utils::sizeToString(_clients.size()) + " connections and " +
+                   Utils::sizeToString(_cgiProcesses.size()) + " CGI processes");
+}
+
+bool Server::isDrained() const {
+    return _clients.empty() && _cgiProcesses.empty();
+}
+
+// Between requests with nothing left to send: safe to close without losing a response
+bool Server::isIdle(const Client& client) {
+    return client.getState() == Client::STATE_READING_HEADERS && client.getBuffer().empty() &&
+           !client.isAwaitingResponse() && client.getOutput().empty();
+}
+
+// Accepts one connection as a non-blocking, close-on-exec socket
+static int acceptNonBlocking(int serverSocket, struct sockaddr_in& clientAddr) {
     socklen_t clientLen = sizeof(clientAddr);
-    
+#ifdef __linux__
+    return accept4(serverSocket, (struct sockaddr*)&clientAddr, &clientLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
     int clientFd = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientLen);
-    if (clientFd < 0) {
-        // For non-blocking sockets, since poll() indicated connection is ready,
-        // a negative return typically indicates an error
+    if (clientFd >= 0) {
+        fcntl(clientFd, F_SETFL, fcntl(clientFd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+    }
+    return clientFd;
+#endif
+}
+
+bool Server::acceptNewConnection(int serverSocket) {
+    ServerInfo* listener = findListener(serverSocket);
+    if (!listener) {
         return false;
     }
     
-    int flags = fcntl(clientFd, F_GETFL, 0);
-    if (fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) < 0) {
-        Utils::logError("Failed to set client socket non-blocking");
-        close(clientFd);
-        return false;
+    // Drain the backlog in one wakeup, bounded so a storm cannot starve established clients
+    int batch = _config.getGlobalConfig().acceptBatch;
+    int accepted = 0;
+    while (accepted < batch) {
+        struct sockaddr_in clientAddr;
+        int clientFd = acceptNonBlocking(serverSocket, clientAddr);
+        if (clientFd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue; // Peer gave up while queued; try the next one
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            ++listener->acceptErrors;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Out of descriptors: the listener stays readable, so back off instead of spinning
+                Utils::logError("accept failed: " + std::string(strerror(errno)) + "; pausing accepts");
+                pauseAccepting(*listener);
+            } else {
+                Utils::logError("accept failed: " + std::string(strerror(errno)));
+            }
+            break;
+        }
+        
+        if (registerClient(clientFd, serverSocket, clientAddr)) {
+            ++accepted;
+        }
     }
     
+    recordAccepts(*listener, accepted, accepted == batch);
+    return accepted > 0;
+}
+
+bool Server::registerClient(int clientFd, int serverSocket, const struct sockaddr_in& clientAddr) {
+#ifndef __linux__
+    // Linux accepted sockets inherit TCP_NODELAY from the listener
     int nodelay = 1;
     if (setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0) {
         Utils::logError("Failed to set TCP_NODELAY (non-fatal): " + std::string(strerror(errno)));
     }
+#endif
     
-    struct pollfd clientPollFd;
-    clientPollFd.fd = clientFd;
-    clientPollFd.events = POLLIN;
-    clientPollFd.revents = 0;
-    _pollFds.push_back(clientPollFd);
+    if (!_eventLoop.add(clientFd, EventLoop::HANDLER_CLIENT, EventLoop::EVENT_READ)) {
+        close(clientFd);
+        return false;
+    }
     
     _clients[clientFd] = Client(clientFd);
     _clientServerSockets[clientFd] = serverSocket; // Track which server socket this client came from
     
-    std::string clientIP = Utils::getClientIP(clientFd);
+    Client& client = _clients[clientFd];
+    client.setPeerAddress(clientAddr);
+    std::map<int, ServerConfig>::const_iterator configIt = _serverConfigs.find(serverSocket);
+    client.setServerConfig(configIt != _serverConfigs.end() ? &configIt->second : &_defaultServerConfig);
+    client.setTimer(_timers.create(TimerWheel::TIMER_CLIENT, clientFd));
+    refreshClientTimer(client);
     
     return true;
 }
 
+Server::ServerInfo* Server::findListener(int serverSocket) {
+    for (size_t i = 0; i < _servers.size(); ++i) {
+        if (_servers[i].socket == serverSocket) {
+            return &_servers[i];
+        }
+    }
+    return NULL;
+}
+
+void Server::recordAccepts(ServerInfo& listener, int accepted, bool batchFull) {
+    listener.accepted += accepted;
+    if (batchFull) {
+        ++listener.fullBatches;
+    }
+    
+    uint64_t elapsed = _now - listener.windowStart;
+    if (elapsed >= 1000) {
+        unsigned long rate = static_cast<unsigned long>(listener.windowAccepted * 1000 / elapsed);
+        listener.peakRate = std::max(listener.peakRate, rate);
+        listener.windowStart = _now;
+        listener.windowAccepted = 0;
+    }
+    listener.windowAccepted += accepted;
+}
+
+void Server::pauseAccepting(ServerInfo& listener) {
+    _eventLoop.modify(listener.socket, 0);
+    _timers.arm(listener.resumeTimer, _now + ACCEPT_PAUSE_MS);
+}
+
 void Server::handleClientRead(int clientFd) {
     Client& client = _clients[clientFd];
     
@@ -248,78 +477,118 @@ void Server::handleClientRead(int clientFd) {
         removeClient(clientFd);
         return;
     }
+    processBufferedRequests(clientFd);
+}
 
-	if (client.getState() == Client::STATE_HEADERS_COMPLETE) {
-		// Headers are parsed, but we haven't started reading the body.
-		// This is our chance to check maxBodySize.
+// Handles every complete request sitting in the client's buffer, in arrival order.
+// Stops at an incomplete request, or once a response has to be produced
+// asynchronously (CGI) so that later responses cannot overtake it.
+void Server::processBufferedRequests(int clientFd) {
+    while (true) {
+        std::map<int, Client>::iterator it = _clients.find(clientFd);
+        if (it == _clients.end()) {
+            return; // Removed by a handler
+        }
+        Client& client = it->second;
+        if (client.isAwaitingResponse() || client.shouldCloseAfterWrite() ||
+            client.getOutput().memorySize() >= OUTPUT_HIGH_WATER) {
+            break;
+        }
 
-		// Get config
-		ServerConfig serverConfig = getServerConfig(clientFd);
-		HttpRequest tempRequest(client.getRequest(), ""); // Parse headers
-		if (!tempRequest.isValid()) {
-			HttpResponse response = createErrorResponse(400, serverConfig);
-			queueResponse(clientFd, response);
-			return;
-		}
-		LocationConfig location = _config.getLocationConfig(serverConfig, tempRequest.getUri(), tempRequest.getMethod());
-
-		// Use location-specific maxBodySize if set, otherwise use server default
-		size_t maxBodySize = (location.maxBodySize > 0) ? location.maxBodySize : serverConfig.maxBodySize;
-
-		std::string extension = Utils::getFileExtension(tempRequest.getUri());
-		if (extension == ".bla") {
-				// For .bla files, check if any .bla regex CGI handler exists
-				for (size_t i = 0; i < serverConfig.locations.size(); ++i) {
-					const LocationConfig& regexLoc = serverConfig.locations[i];
-					if (regexLoc.isRegex && !regexLoc.cgiPath.empty() && regexLoc.path.find(".bla") != std::string::npos) {
-						// Found one, so apply the larger limit
-						// maxBodySize = std::max(maxBodySize, static_cast<size_t>(100 * 1024 * 1024));
-						// Utils::logInfo("Found .bla regex config, increasing maxBodySize to 100MB");
-						break;
-					}
-				}
-			}
-
-		if (client.isChunked()) {
-			Utils::logInfo("Chunked encoding detected. Setting max body size to " + Utils::sizeToString(maxBodySize));
-		} else if (client.getContentLength() > 0) {
-			Utils::logInfo("Content-Length detected. Setting max body size to " + Utils::sizeToString(maxBodySize));
-		}
+        if (client.getState() == Client::STATE_HEADERS_COMPLETE) {
+            // Headers are parsed, but we haven't started reading the body.
+            // This is our chance to check maxBodySize.
+            const ServerConfig& serverConfig = getServerConfig(clientFd);
+            const HttpRequest& request = client.getRequest(); // Parsed by the client, once
+            if (!request.isValid()) {
+                HttpResponse response = createErrorResponse(400, serverConfig);
+                response.setHeader("Connection", "close");
+                queueResponse(clientFd, response);
+                client.markForCloseAfterWrite(); // The body cannot be framed, so neither can what follows
+                break;
+            }
+            // Resolved here for the body limit and reused when the request is processed
+            client.setLocation(_config.getLocationConfig(serverConfig, request.getUri(), request.getMethod()));
+            const LocationConfig& location = client.getLocation();
+
+            // Use location-specific maxBodySize if set, otherwise use server default
+            size_t maxBodySize = (location.maxBodySize > 0) ? location.maxBodySize : serverConfig.maxBodySize;
+
+            std::string extension = Utils::getFileExtension(request.getUri());
+            if (extension == ".bla") {
+                // For .bla files, check if any .bla regex CGI handler exists
+                for (size_t i = 0; i < serverConfig.locations.size(); ++i) {
+                    const LocationConfig& regexLoc = serverConfig.locations[i];
+                    if (regexLoc.isRegex && !regexLoc.cgiPath.empty() && regexLoc.path.find(".bla") != std::string::npos) {
+                        // Found one, so apply the larger limit
+                        // maxBodySize = std::max(maxBodySize, static_cast<size_t>(100 * 1024 * 1024));
+                        // Utils::logInfo("Found .bla regex config, increasing maxBodySize to 100MB");
+                        break;
+                    }
+                }
+            }
 
-		// Tell the client to start reading the body
-		client.beginReadingBody(maxBodySize);
+            if (client.isChunked()) {
+                Utils::logInfo("Chunked encoding detected. Setting max body size to " + Utils::sizeToString(maxBodySize));
+            } else if (client.getContentLength() > 0) {
+                Utils::logInfo("Content-Length detected. Setting max body size to " + Utils::sizeToString(maxBodySize));
+            }
 
-		// Call readData() again to process any body data already in the buffer
-		if (!client.readData()) {
-			removeClient(clientFd);
-			return;
-		}
-	}
+            // Tell the client to start reading the body. Uploads spool on the upload
+            // volume, so storing them is a link rather than a copy.
+            client.beginReadingBody(maxBodySize, serverConfig.clientBodyBufferSize, location.uploadPath);
 
-	if (client.isRequestComplete()) {
-		if (client.shouldStopReading()) {
-			// This was set by the client's internal maxBodySize check
-			Utils::logError("Request body exceeded max size during streaming. Queuing 413 and closing connection.");
-			ServerConfig serverConfig = getServerConfig(clientFd);
-			HttpResponse response = createErrorResponse(413, serverConfig);
-			// Ensure Connection: close header for 413
-			response.setHeader("Connection", "close"); 
-			queueResponse(clientFd, response);
-			client.markForCloseAfterWrite(); // Tell server to close after sending 413
-			
-			// Clean up the temporary body file if it exists
-			if (!client.getBodyFilePath().empty()) {
-				cleanupTempFile(client.getBodyFilePath());
-			}
-			
-			client.clearRequest(); // Clear the request state
-			return; // Stop processing this client for reads
-		}
+            // Process any body data already in the buffer
+            client.parseBufferedRequest();
+
+            // The interim response goes out only once the body has passed the size
+            // check, and behind the responses to earlier pipelined requests. A body
+            // that arrived without waiting for it needs none.
+            if (client.expectsContinue() && !client.shouldStopReading() && !client.isRequestComplete()) {
+                client.getOutput().append("HTTP/1.1 100 Continue\r\n\r\n");
+                updatePollEvents(clientFd);
+            }
+        }
+
+        if (!client.isRequestComplete()) {
+            break;
+        }
+
+        if (client.shouldStopReading()) {
+            // Set by the client's maxBodySize check, or when the body could not be stored
+            const ServerConfig& serverConfig = getServerConfig(clientFd);
+            HttpResponse response;
+            if (client.hasBodyFailed()) {
+                Utils::logError("Request body could not be stored. Queuing 500 and closing connection.");
+                response = createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
+            } else {
+                Utils::logError("Request body exceeded max size during streaming. Queuing 413 and closing connection.");
+                response = createErrorResponse(413, serverConfig);
+            }
+            // Ensure Connection: close header, the rest of the body is never read
+            response.setHeader("Connection", "close"); 
+            queueResponse(clientFd, response);
+            client.markForCloseAfterWrite(); // Tell server to close after sending the error
+            
+            client.clearRequest(); // Clear the request state, dropping the body
+            return; // Stop processing this client for reads
+        }
         Utils::logInfo("Request complete for client " + Utils::intToString(clientFd) + ", processing...");
         
-        processHttpRequest(clientFd, client.getRequest(), client.getBodyFilePath());
+        processHttpRequest(clientFd, client);
         
-        client.clearRequest();
+        // Start on the next pipelined request, if its bytes are already here
+        it = _clients.find(clientFd);
+        if (it == _clients.end()) {
+            return;
+        }
+        it->second.clearRequest();
+        it->second.parseBufferedRequest();
+    }
+    
+    std::map<int, Client>::iterator it = _clients.find(clientFd);
+    if (it != _clients.end()) {
+        refreshClientTimer(it->second);
     }
 }
 
@@ -329,27 +598,24 @@ void Server::handleClientWrite(int clientFd) {
     }
 }
 
-void Server::processHttpRequest(int clientFd, const std::string& headers, const std::string& bodyFilePath) {
-    HttpRequest httpRequest(headers, bodyFilePath);
+void Server::processHttpRequest(int clientFd, Client& client) {
+    const HttpRequest& httpRequest = client.getRequest();
 	HttpResponse response;
-    bool tempFileHandedToCGI = false; // Track if temp file ownership transferred to CGI
     
+    const ServerConfig& serverConfig = client.getServerConfig() ? *client.getServerConfig() : _defaultServerConfig;
     if (!httpRequest.isValid()) {
-        ServerConfig serverConfig = getServerConfig(clientFd);
         response = createErrorResponse(HTTP_BAD_REQUEST, serverConfig);
     } else {
-        ServerConfig serverConfig = getServerConfig(clientFd);
-        
-        LocationConfig locationConfig = _config.getLocationConfig(serverConfig, httpRequest.getUri(), httpRequest.getMethod());
+        if (!client.hasLocation()) {
+            // Bodiless requests skip the header-time check that resolves it
+            client.setLocation(_config.getLocationConfig(serverConfig, httpRequest.getUri(), httpRequest.getMethod()));
+        }
+        const LocationConfig& locationConfig = client.getLocation();
         
         // Check for redirections first
         if (!locationConfig.redirections.empty()) {
             response = handleRedirection(locationConfig);
             queueResponse(clientFd, response);
-            // Clean up temp file before returning
-            if (!bodyFilePath.empty()) {
-                cleanupTempFile(bodyFilePath);
-            }
             return;
         }
         
@@ -362,36 +628,36 @@ void Server::processHttpRequest(int clientFd, const std::string& headers, const
                 std::string extension = Utils::getFileExtension(filePath);
                 
                 if ((extension == ".php" || extension == ".py" || extension == ".sh") && Utils::fileExists(filePath)) {
-                    LocationConfig location = _config.getLocationConfig(serverConfig, httpRequest.getUri(), httpRequest.getMethod());
-                    
                     // Use async CGI for GET requests too
                     if (_cgiProcesses.size() < MAX_CONCURRENT_CGI_PROCESSES) {
-                        if (startAsyncCGI(clientFd, filePath, httpRequest, serverConfig, location, "")) {
-                            tempFileHandedToCGI = true;
+                        if (startAsyncCGI(clientFd, filePath, httpRequest, serverConfig, locationConfig)) {
+                            awaitAsyncResponse(clientFd);
                             return; // CGI started, response will be sent when ready
                         }
+                        return; // startAsyncCGI() already queued an error response
                     } else {
                         // Queue the CGI request
-                        queueCgiRequest(clientFd, filePath, httpRequest, serverConfig, location);
-                        tempFileHandedToCGI = true;
+                        queueCgiRequest(clientFd, filePath, httpRequest, serverConfig, locationConfig);
+                        awaitAsyncResponse(clientFd);
                         return;
                     }
                 }
                 
                 // Not a CGI request or async CGI failed, handle normally
                 response = handleGETRequest(httpRequest, serverConfig);
+                compressResponse(httpRequest, locationConfig, response);
                 if (httpRequest.getMethod() == "HEAD") {
-                    response.setBody("");
+                    response.dropBody(); // Keeps Content-Length of the GET response
                 }
             } else if (httpRequest.getMethod() == "POST") {
                 // Check if this should use async CGI
                 std::string filePath = resolveFilePath(httpRequest.getUri(), serverConfig);
                 std::string extension = Utils::getFileExtension(filePath);
                 
-                if ((extension == ".bla" || !httpRequest.getBodyFilePath().empty()) &&
+                if ((extension == ".bla" || httpRequest.getBody().isOpen()) &&
                     (extension == ".php" || extension == ".py" || extension == ".sh" || extension == ".bla")) {
                     
-                    LocationConfig location = _config.getLocationConfig(serverConfig, httpRequest.getUri(), httpRequest.getMethod());
+                    LocationConfig location = locationConfig; // May be swapped for the .bla handler below
                     bool canExecuteCGI = Utils::fileExists(filePath) || (location.isRegex && !location.cgiPath.empty());
 
 					if (extension == ".bla") {
@@ -416,20 +682,22 @@ void Server::processHttpRequest(int clientFd, const std::string& headers, const
                     if (canExecuteCGI) {
                         // Queue CGI request or start immediately if capacity allows
                         if (_cgiProcesses.size() < MAX_CONCURRENT_CGI_PROCESSES) {
-							if (startAsyncCGI(clientFd, filePath, httpRequest, serverConfig, location, httpRequest.getBodyFilePath())) {
-								tempFileHandedToCGI = true;
-								return;
+							if (startAsyncCGI(clientFd, filePath, httpRequest, serverConfig, location)) {
+								awaitAsyncResponse(clientFd);
 							}
+							// Otherwise startAsyncCGI() already queued an error response
+							return;
                         } else {
                             // Queue the request for later processing
                             queueCgiRequest(clientFd, filePath, httpRequest, serverConfig, location);
-                            tempFileHandedToCGI = true;
+                            awaitAsyncResponse(clientFd);
                             return; // Don't queue any response - will be handled when CGI slot becomes available
                         }
                     }
                 }
                 // Fall back to synchronous handling
-                response = handlePOSTRequest(httpRequest, serverConfig);
+                response = handlePOSTRequest(httpRequest, serverConfig, locationConfig);
+                compressResponse(httpRequest, locationConfig, response);
             } else if (httpRequest.getMethod() == "PUT") {
                 response = handlePUTRequest(httpRequest, serverConfig);
             } else if (httpRequest.getMethod() == "DELETE") {
@@ -441,103 +709,139 @@ void Server::processHttpRequest(int clientFd, const std::string& headers, const
     }
     
     queueResponse(clientFd, response);
-    
-    // Clean up temporary body file if not handed to CGI
-    if (!bodyFilePath.empty() && !tempFileHandedToCGI) {
-        cleanupTempFile(bodyFilePath);
-    }
 }
 
-void Server::queueResponse(int clientFd, const HttpResponse& response) {
-    // Make a copy to add headers
-    HttpResponse modifiedResponse = response;
+void Server::queueResponse(int clientFd, HttpResponse& response) {
+    std::map<int, Client>::iterator clientIt = _clients.find(clientFd);
+    if (clientIt == _clients.end()) {
+        return; // Client went away (e.g. while its CGI was running)
+    }
+    Client& client = clientIt->second;
     
-    // Add Connection keep-alive header for HTTP/1.1
-    if (modifiedResponse.getHeader("Connection").empty()) {
-        modifiedResponse.setHeader("Connection", "keep-alive");
+    // A draining server answers what it has been asked and closes
+    if (_draining) {
+        response.setHeader("Connection", "close");
+        client.markForCloseAfterWrite();
     }
     
-    std::string responseStr = modifiedResponse.toString();
+    // Add Connection keep-alive header for HTTP/1.1
+    if (response.getHeader("Connection").empty()) {
+        response.setHeader("Connection", "keep-alive");
+    }
+    
+    // Header block and body become separate segments; the body is moved, not copied,
+    // a static file body is queued as a descriptor range for sendfile(), and a
+    // cached one as a reference to the cache's buffer.
+    // Responses to pipelined requests queue up behind each other in request order.
+    OutputQueue& output = client.getOutput();
+    std::string head;
+    response.serializeHeaders(head);
+    output.appendSwap(head);
+    if (response.hasBodyFile()) {
+        const std::vector<HttpResponse::FilePart>& parts = response.getBodyFileParts();
+        for (size_t i = 0; i < parts.size(); ++i) {
+            output.append(parts[i].header);
+            output.appendFile(response.getBodyFile(), parts[i].offset, parts[i].length);
+        }
+    }
+    output.appendShared(response.getSharedBody());
+    std::string body;
+    response.takeBody(body);
+    output.appendSwap(body);
     
-    _pendingWrites[clientFd] = responseStr;
-    _writeOffsets[clientFd] = 0;
+    if (client.isAwaitingResponse()) {
+        // The outstanding async response is in; pick up any requests held behind it
+        client.setAwaitingResponse(false);
+        _pipelineResume.push_back(clientFd);
+    }
     
     updatePollEvents(clientFd);
 }
 
+void Server::awaitAsyncResponse(int clientFd) {
+    std::map<int, Client>::iterator clientIt = _clients.find(clientFd);
+    if (clientIt != _clients.end()) {
+        clientIt->second.setAwaitingResponse(true);
+        updatePollEvents(clientFd);
+    }
+}
+
+void Server::resumePipelinedRequests() {
+    // Swap out first: processing may queue further resumptions
+    std::vector<int> pending;
+    pending.swap(_pipelineResume);
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (_clients.find(pending[i]) != _clients.end()) {
+            processBufferedRequests(pending[i]);
+        }
+    }
+}
+
 bool Server::writeToClient(int clientFd) {
-    if (_pendingWrites.find(clientFd) == _pendingWrites.end()) {
-        return true; // No pending writes
+    std::map<int, Client>::iterator clientIt = _clients.find(clientFd);
+    if (clientIt == _clients.end()) {
+        return true;
     }
+    Client& client = clientIt->second;
+    OutputQueue& output = client.getOutput();
     
-    const std::string& response = _pendingWrites[clientFd];
-    size_t offset = _writeOffsets[clientFd];
+    bool wasAboveHighWater = output.memorySize() >= OUTPUT_HIGH_WATER;
+    ssize_t bytesSent = output.flush(clientFd);
+    if (bytesSent < 0) {
+        // Connection closed or error
+        return false;
+    }
     
-    ssize_t bytesSent = send(clientFd, response.c_str() + offset, response.length() - offset, 0);
+    if (bytesSent > 0) {
+        // Progress on a slow download counts as activity
+        refreshClientTimer(client);
+    }
     
-    if (bytesSent <= 0) {
-        // Connection closed or error - poll() should have indicated socket is ready
-        return false;
+    if (output.empty() && (client.shouldCloseAfterWrite() || (_draining && isIdle(client)))) {
+        Utils::logInfo("Closing connection for client " + Utils::intToString(clientFd) + " after its last response.");
+        return false; // Caller removes the client
     }
     
-    _writeOffsets[clientFd] += bytesSent;
+    if (wasAboveHighWater && output.memorySize() < OUTPUT_HIGH_WATER) {
+        // The reader caught up; continue with pipelined requests held back by backpressure
+        _pipelineResume.push_back(clientFd);
+    }
     
-	if (_writeOffsets[clientFd] >= response.length()) {
-    	// Write complete
-    	bool shouldClose = false;
-		if (_clients.count(clientFd)) { // Check if client still exists
-			shouldClose = _clients[clientFd].shouldCloseAfterWrite();
-		}
-
-		_pendingWrites.erase(clientFd);
-		_writeOffsets.erase(clientFd);
-
-		if (shouldClose) {
-			Utils::logInfo("Closing connection for client " + Utils::intToString(clientFd) + " after error response.");
-			removeClient(clientFd); 
-			return false; // Indicate client was removed
-		} else {
-			// Normal keep-alive: update poll events and wait for next request
-			updatePollEvents(clientFd);
-			return true;
-		}
-	}
-
+    updatePollEvents(clientFd);
     return true;
 }
 
 void Server::updatePollEvents(int clientFd) {
-    for (size_t i = 0; i < _pollFds.size(); ++i) {
-        if (_pollFds[i].fd == clientFd) {
-            _pollFds[i].events = POLLIN;
-            if (_pendingWrites.find(clientFd) != _pendingWrites.end()) {
-                _pollFds[i].events |= POLLOUT;
-            }
-            break;
-        }
+    std::map<int, Client>::const_iterator clientIt = _clients.find(clientFd);
+    if (clientIt == _clients.end()) {
+        return;
     }
+    const Client& client = clientIt->second;
+    const OutputQueue& output = client.getOutput();
+    
+    // Stop reading while an async response is outstanding (the pipelined requests
+    // behind it stay in the kernel buffer until their turn), or while a slow reader
+    // has more than OUTPUT_HIGH_WATER bytes of memory waiting (file ranges are not counted)
+    int events = 0;
+    if (!client.isAwaitingResponse() && output.memorySize() < OUTPUT_HIGH_WATER) {
+        events |= EventLoop::EVENT_READ;
+    }
+    if (!output.empty()) {
+        events |= EventLoop::EVENT_WRITE;
+    }
+    _eventLoop.modify(clientFd, events);
 }
 
 void Server::removeClient(int clientFd) {
-    // Clean up any temp file before removing the client
+    // The request body, if any, is released along with the client
     std::map<int, Client>::iterator clientIt = _clients.find(clientFd);
     if (clientIt != _clients.end()) {
-        const std::string& bodyFilePath = clientIt->second.getBodyFilePath();
-        if (!bodyFilePath.empty()) {
-            cleanupTempFile(bodyFilePath);
-        }
+        _timers.release(clientIt->second.getTimer());
     }
     
-    for (std::vector<struct pollfd>::iterator it = _pollFds.begin(); it != _pollFds.end(); ++it) {
-        if (it->fd == clientFd) {
-            _pollFds.erase(it);
-            break;
-        }
-    }
+    _eventLoop.remove(clientFd);
 
     _clients.erase(clientFd);
-    _pendingWrites.erase(clientFd);
-    _writeOffsets.erase(clientFd);
     _clientServerSockets.erase(clientFd); // Clean up server socket mapping
 
     close(clientFd);
@@ -550,18 +854,65 @@ void Server::stop() {
         close(it->first);
     }
     _clients.clear();
-    _pollFds.clear();
-    _pendingWrites.clear();
-    _writeOffsets.clear();
+    _pipelineResume.clear();
+    _eventLoop.close();
+    if (_fileCache.hits() > 0 || _fileCache.misses() > 0) {
+        Utils::logInfo("File cache: " + Utils::sizeToString(_fileCache.hits()) + " hits, " +
+                       Utils::sizeToString(_fileCache.misses()) + " misses, " +
+                       Utils::sizeToString(_fileCache.bytes()) + " bytes cached");
+    }
+    _fileCache.close();
+    if (_openFiles.hits() > 0 || _openFiles.misses() > 0) {
+        Utils::logInfo("Open file cache: " + Utils::sizeToString(_openFiles.hits()) + " hits, " +
+                       Utils::sizeToString(_openFiles.misses()) + " misses");
+    }
+    _openFiles.clear();
     _clientServerSockets.clear(); // Clear client-server socket mapping
     
-    // Close all server sockets
+    closeListeners();
     for (size_t i = 0; i < _servers.size(); ++i) {
-        close(_servers[i].socket);
+        const ServerInfo& listener = _servers[i];
+        if (listener.accepted > 0 || listener.acceptErrors > 0) {
+            Utils::logInfo("Listener " + listener.config.host + ":" + Utils::intToString(listener.config.port) +
+                           " accepted " + Utils::sizeToString(listener.accepted) +
+                           " connections (peak " + Utils::sizeToString(std::max(listener.peakRate, listener.windowAccepted)) +
+                           "/s, " + Utils::sizeToString(listener.fullBatches) + " full batches, " +
+                           Utils::sizeToString(listener.acceptErrors) + " errors)");
+        }
     }
     _servers.clear();
     _serverConfigs.clear();
     
+    for (int i = 0; i < 2; ++i) {
+        if (_wakePipe[i] >= 0) {
+            close(_wakePipe[i]);
+            _wakePipe[i] = -1;
+        }
+    }
+}
+
+void Server::closeListeners() {
+    for (size_t i = 0; i < _servers.size(); ++i) {
+        ServerInfo& listener = _servers[i];
+        if (listener.socket < 0) {
+            continue;
+        }
+        _timers.release(listener.resumeTimer);
+        listener.resumeTimer = TimerWheel::INVALID_TIMER;
+        _eventLoop.remove(listener.socket);
+        close(listener.socket);
+        listener.socket = -1;
+    }
+}
+
+void Server::requestStop() {
+    _stopRequested = true;
+    if (_wakePipe[1] >= 0) {
+        char byte = 0;
+        ssize_t ignored = write(_wakePipe[1], &byte, 1);
+        (void)ignored;
+    }
+    
 }
 
 HttpResponse Server::handleGETRequest(const HttpRequest& request, const ServerConfig& serverConfig) {
@@ -570,32 +921,65 @@ HttpResponse Server::handleGETRequest(const HttpRequest& request, const ServerCo
     // CGI requests should now be handled asynchronously before reaching here
     // This function only handles static files and directories
     
-    if (Utils::fileExists(filePath)) {
-        if (Utils::isDirectory(filePath)) {
-            return handleDirectoryRequest(filePath, request.getUri(), serverConfig);
-        } else {
-            return serveStaticFile(filePath, serverConfig);
-        }
+    // Ranges are cut from the file itself, so they bypass the content cache
+    bool cacheable = _fileCache.isEnabled() && request.getHeader("Range").empty();
+    
+    // A precompressed sidecar the client accepts replaces the file, sent through the
+    // same descriptor path; the content cache only ever holds identity bodies
+    FileHandle variant;
+    std::string encoding;
+    bool varies = findPrecompressed(filePath, request, serverConfig, variant, encoding);
+    const FileCache::Entry* cached = (cacheable && !variant.isOpen()) ? _fileCache.lookup(filePath, _now) : NULL;
+    
+    HttpResponse response;
+    if (variant.isOpen()) {
+        response = HttpResponse::createFileResponse(variant);
+        response.setContentType(HttpResponse::getMimeType(filePath));
+        response.setHeader("Content-Encoding", encoding);
+    } else if (cached) {
+        response = createCachedFileResponse(*cached);
     } else {
-        return createErrorResponse(HTTP_NOT_FOUND, serverConfig);
+        response = servePath(filePath, request.getUri(), serverConfig);
+        if (cacheable && response.getStatusCode() == HTTP_OK && response.hasBodyFile()) {
+            _fileCache.insert(filePath, response.getBodyFile(), response.getHeader("Content-Type"),
+                              response.getHeader("ETag"), _now);
+        }
+    }
+    
+    if (varies && response.getStatusCode() == HTTP_OK) {
+        response.setHeader("Vary", "Accept-Encoding");
     }
+    
+    // A client whose copy is still current gets the validators only
+    if (response.isNotModified(request.getHeader("If-None-Match"), request.getHeader("If-Modified-Since"))) {
+        response.setNotModified();
+        return response;
+    }
+    
+    // Byte ranges only apply to GET, and only to bodies served from a file
+    if (request.getMethod() == "GET" && response.hasBodyFile()) {
+        std::string ifRange = request.getHeader("If-Range");
+        HttpResponse::RangeResult result = response.applyRange(request.getHeader("Range"),
+                                                               request.hasHeader("If-Range") ? &ifRange : NULL);
+        if (result == HttpResponse::RANGE_UNSATISFIABLE) {
+            HttpResponse error = createErrorResponse(HTTP_RANGE_NOT_SATISFIABLE, serverConfig);
+            error.setHeader("Content-Range", "bytes */" + Utils::sizeToString(response.getBodyFile().size()));
+            return error;
+        }
+    }
+    return response;
 }
 
-HttpResponse Server::handlePOSTRequest(const HttpRequest& request, const ServerConfig& serverConfig) {
+HttpResponse Server::handlePOSTRequest(const HttpRequest& request, const ServerConfig& serverConfig,
+                                       const LocationConfig& bodyCheckLocation) {
     // Validate body size against location-specific limits
-    LocationConfig bodyCheckLocation = _config.getLocationConfig(serverConfig, request.getUri(), request.getMethod());
     size_t maxBodySize = (bodyCheckLocation.maxBodySize > 0) ? bodyCheckLocation.maxBodySize : serverConfig.maxBodySize;
 
-	if (!request.getBodyFilePath().empty()) {
-        struct stat st;
-        if (stat(request.getBodyFilePath().c_str(), &st) == 0) {
-            if (st.st_size > static_cast<long>(maxBodySize)) {
-                Utils::logError("POST body file size " + Utils::sizeToString(st.st_size) + 
-                               " exceeds limit " + Utils::sizeToString(maxBodySize) + 
-                               " for location " + bodyCheckLocation.path);
-                return createErrorResponse(413, serverConfig);
-            }
-        }
+	if (request.getBody().size() > maxBodySize) {
+        Utils::logError("POST body size " + Utils::sizeToString(request.getBody().size()) + 
+                       " exceeds limit " + Utils::sizeToString(maxBodySize) + 
+                       " for location " + bodyCheckLocation.path);
+        return createErrorResponse(413, serverConfig);
     }
 
     std::string contentType = request.getHeader("Content-Type");
@@ -644,20 +1028,11 @@ HttpResponse Server::handlePUTRequest(const HttpRequest& request, const ServerCo
         return createErrorResponse(HTTP_FORBIDDEN, serverConfig);
     }
 
-	std::ifstream srcFile(request.getBodyFilePath().c_str(), std::ios::binary);
-    if (!srcFile.is_open()) {
-        Utils::logError("PUT: Failed to open temp body file: " + request.getBodyFilePath());
-        return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
-    }
-    std::ofstream destFile(filePath.c_str(), std::ios::binary);
-    if (!destFile.is_open()) {
-        Utils::logError("PUT: Failed to open destination file: " + filePath);
-        srcFile.close();
+	if (!request.getBody().saveTo(filePath)) {
+        Utils::logError("PUT: Failed to store body at: " + filePath);
         return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
     }
-    destFile << srcFile.rdbuf();
-    srcFile.close();
-    destFile.close();
+    invalidateCachedPath(filePath);
 
     Utils::logInfo("File uploaded via PUT: " + filePath);
     
@@ -689,6 +1064,7 @@ HttpResponse Server::handleDELETERequest(const HttpRequest& request, const Serve
     
     // Attempt to delete the file
     if (unlink(filePath.c_str()) == 0) {
+        invalidateCachedPath(filePath);
         Utils::logInfo("File deleted: " + filePath);
         
         HttpResponse response;
@@ -702,8 +1078,148 @@ HttpResponse Server::handleDELETERequest(const HttpRequest& request, const Serve
     }
 }
 
-HttpResponse Server::serveStaticFile(const std::string& path, const ServerConfig& /* serverConfig */) {
-    return HttpResponse::createFileResponse(path);
+HttpResponse Server::serveStaticFile(const std::string& path, const ServerConfig& serverConfig) {
+    OpenFileCache::Lookup found = _openFiles.lookup(path, _now);
+    if (found.kind != OpenFileCache::KIND_FILE) {
+        bool forbidden = found.kind == OpenFileCache::KIND_ERROR && found.error == EACCES;
+        return createErrorResponse(forbidden ? HTTP_FORBIDDEN : HTTP_NOT_FOUND, serverConfig);
+    }
+    return HttpResponse::createFileResponse(found.file);
+}
+
+// Static GET target: a file, or a directory answered by its index or a listing.
+// Path lookups go through the open file cache.
+HttpResponse Server::servePath(const std::string& filePath, const std::string& uri, const ServerConfig& serverConfig) {
+    OpenFileCache::Lookup found = _openFiles.lookup(filePath, _now);
+    switch (found.kind) {
+        case OpenFileCache::KIND_FILE:
+            return HttpResponse::createFileResponse(found.file);
+        case OpenFileCache::KIND_DIRECTORY:
+            return handleDirectoryRequest(filePath, uri, serverConfig);
+        case OpenFileCache::KIND_ERROR:
+            if (found.error == EACCES) {
+                return createErrorResponse(HTTP_FORBIDDEN, serverConfig);
+            }
+            return createErrorResponse(HTTP_NOT_FOUND, serverConfig);
+        default:
+            return createErrorResponse(HTTP_NOT_FOUND, serverConfig);
+    }
+}
+
+// Looks for filePath.br / filePath.gz when enabled for the server. Returns true if
+// one exists, i.e. the response varies with Accept-Encoding; `variant` is opened
+// only when the client accepts that coding (br is preferred).
+bool Server::findPrecompressed(const std::string& filePath, const HttpRequest& request, const ServerConfig& serverConfig,
+                               FileHandle& variant, std::string& encoding) {
+    static const char* const codings[] = {"br", "gzip"};
+    static const char* const suffixes[] = {".br", ".gz"};
+    bool enabled[] = {serverConfig.brotliStatic, serverConfig.gzipStatic};
+    bool exists = false;
+    
+    for (size_t i = 0; i < 2; ++i) {
+        if (!enabled[i]) {
+            continue;
+        }
+        OpenFileCache::Lookup found = _openFiles.lookup(filePath + suffixes[i], _now);
+        if (found.kind != OpenFileCache::KIND_FILE) {
+            continue;
+        }
+        exists = true;
+        if (!variant.isOpen() && request.acceptsEncoding(codings[i])) {
+            variant = found.file;
+            encoding = codings[i];
+        }
+    }
+    return exists;
+}
+
+bool Server::compressionApplies(const LocationConfig& location, const std::string& contentType) {
+    if (!location.gzip) {
+        return false;
+    }
+    std::string type = Utils::toLower(Utils::trim(contentType.substr(0, contentType.find(';'))));
+    for (size_t i = 0; i < location.gzipTypes.size(); ++i) {
+        if (location.gzipTypes[i] == "*" || Utils::toLower(location.gzipTypes[i]) == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// gzip is preferred; "deflate" is the zlib-wrapped stream per RFC 9110
+bool Server::negotiateCompression(const HttpRequest& request, Compressor::Format& format) {
+    if (request.acceptsEncoding("gzip")) {
+        format = Compressor::FORMAT_GZIP;
+        return true;
+    }
+    if (request.acceptsEncoding("deflate")) {
+        format = Compressor::FORMAT_DEFLATE;
+        return true;
+    }
+    return false;
+}
+
+void Server::compressResponse(const HttpRequest& request, const LocationConfig& location, HttpResponse& response) {
+    int status = response.getStatusCode();
+    if (!response.isCompressible() || status < 200 || status >= 300 || status == HTTP_NO_CONTENT ||
+        response.hasBodyFile() || !response.getHeader("Content-Encoding").empty() ||
+        !compressionApplies(location, response.getHeader("Content-Type"))) {
+        return;
+    }
+    
+    response.setHeader("Vary", "Accept-Encoding");
+    Compressor::Format format;
+    if (response.getBody().length() < location.gzipMinLength || !negotiateCompression(request, format)) {
+        return;
+    }
+    
+    std::string compressed;
+    if (!Compressor::compress(format, location.gzipCompLevel, response.getBody(), compressed)) {
+        return;
+    }
+    response.adoptBody(compressed);
+    response.setHeader("Content-Encoding", Compressor::encodingName(format));
+    
+    // The encoded bytes differ, so a strong validator may no longer be claimed
+    std::string etag = response.getHeader("ETag");
+    if (!etag.empty() && !Utils::startsWith(etag, "W/")) {
+        response.setHeader("ETag", "W/" + etag);
+    }
+}
+
+void Server::invalidateCachedPath(const std::string& path) {
+    _fileCache.invalidate(path);
+    _openFiles.invalidate(path);
+}
+
+HttpResponse Server::createCachedFileResponse(const FileCache::Entry& entry) {
+    HttpResponse response;
+    response.setContentType(entry.mimeType);
+    response.setHeader("Accept-Ranges", "bytes");
+    response.setHeader("Last-Modified", entry.lastModified);
+    response.setHeader("ETag", entry.etag);
+    response.setSharedBody(entry.content);
+    return response;
+}
+
+void Server::warmFileCache() {
+    const std::vector<std::string>& uris = _config.getGlobalConfig().fileCachePrewarm;
+    const std::vector<ServerConfig>& servers = _config.getServers();
+    
+    // Load each URI as every server block would resolve it
+    for (size_t i = 0; i < servers.size(); ++i) {
+        for (size_t j = 0; j < uris.size(); ++j) {
+            if (uris[j].empty()) {
+                continue;
+            }
+            std::string filePath = resolveFilePath(uris[j], servers[i]);
+            HttpResponse response = servePath(filePath, uris[j], servers[i]);
+            if (response.getStatusCode() == HTTP_OK && response.hasBodyFile()) {
+                _fileCache.insert(filePath, response.getBodyFile(), response.getHeader("Content-Type"),
+                                  response.getHeader("ETag"), _now);
+            }
+        }
+    }
 }
 
 HttpResponse Server::handleDirectoryRequest(const std::string& path, const std::string& uri, const ServerConfig& serverConfig) {
@@ -712,13 +1228,13 @@ HttpResponse Server::handleDirectoryRequest(const std::string& path, const std::
     // Check for location-specific default file first, then server default
     std::string indexFile = location.index.empty() ? serverConfig.index : location.index;
     std::string indexPath = path + "/" + indexFile;
-    if (Utils::fileExists(indexPath) && !Utils::isDirectory(indexPath)) {
+    if (_openFiles.lookup(indexPath, _now).kind == OpenFileCache::KIND_FILE) {
         return serveStaticFile(indexPath, serverConfig);
     }
     
     if (uri.find("/directory/") == 0 && uri != "/directory") {
         std::string youpiPath = path + "/youpi.bad_extension";
-        if (Utils::fileExists(youpiPath) && !Utils::isDirectory(youpiPath)) {
+        if (_openFiles.lookup(youpiPath, _now).kind == OpenFileCache::KIND_FILE) {
             return serveStaticFile(youpiPath, serverConfig);
         }
         return createErrorResponse(HTTP_NOT_FOUND, serverConfig);
@@ -767,6 +1283,10 @@ HttpResponse Server::generateDirectoryListing(const std::string& path, const std
     std::vector<std::string> directories;
     std::vector<std::string> files;
     
+    // The listing changes with the directory and with any listed file's size or mtime
+    struct stat dirStat;
+    time_t lastModified = (stat(path.c_str(), &dirStat) == 0) ? dirStat.st_mtime : 0;
+    
     // Separate directories and files
     while ((entry = readdir(dir)) != NULL) {
         std::string name = entry->d_name;
@@ -809,6 +1329,7 @@ HttpResponse Server::generateDirectoryListing(const std::string& path, const std
         if (stat(fullPath.c_str(), &statbuf) == 0) {
             sizeStr = Utils::sizeToString(statbuf.st_size);
             timeStr = Utils::formatTime(statbuf.st_mtime);
+            lastModified = std::max(lastModified, statbuf.st_mtime);
         }
         
         html += "<a href=\"" + filePath + "\">" + files[i] + "</a>";
@@ -826,92 +1347,94 @@ HttpResponse Server::generateDirectoryListing(const std::string& path, const std
     HttpResponse response;
     response.setStatus(HTTP_OK);
     response.setContentType("text/html");
+    response.setHeader("Last-Modified", Utils::formatHttpDate(lastModified));
+    response.setHeader("ETag", HttpResponse::makeWeakETag(html));
     response.setBody(html);
+    response.setCompressible(true);
     return response;
 }
 
 HttpResponse Server::handleFileUpload(const HttpRequest& request, const ServerConfig& serverConfig) {
-    std::string contentType = request.getHeader("Content-Type");
-    std::string boundary;
-    
     // Extract boundary from Content-Type header
-    size_t boundaryPos = contentType.find("boundary=");
-    if (boundaryPos == std::string::npos) {
+    std::string boundary = MultipartParser::boundaryFrom(request.getHeader("Content-Type"));
+    if (boundary.empty()) {
         return HttpResponse::createErrorResponse(HTTP_BAD_REQUEST);
     }
-    
-    boundary = "--" + contentType.substr(boundaryPos + 9);
-	std::string body = Utils::readFile(request.getBodyFilePath());
-    
-    // Parse multipart data
-    std::vector<std::string> parts = Utils::split(body, boundary);
-    
-    for (size_t i = 1; i < parts.size() - 1; ++i) { // Skip first empty part and last boundary
-        std::string part = parts[i];
-        if (part.empty()) continue;
-        
-        // Find headers and content separation
-        size_t headerEnd = part.find("\r\n\r\n");
-        if (headerEnd == std::string::npos) {
-            headerEnd = part.find("\n\n");
-            if (headerEnd == std::string::npos) continue;
-            headerEnd += 2;
-        } else {
-            headerEnd += 4;
-        }
-        
-        std::string headers = part.substr(0, headerEnd);
-        std::string content = part.substr(headerEnd);
-        
-        // Parse Content-Disposition header
-        std::string filename;
-        std::string name;
-        
-        size_t dispositionPos = headers.find("Content-Disposition:");
-        if (dispositionPos != std::string::npos) {
-            std::string disposition = headers.substr(dispositionPos);
-            
-            // Extract filename
-            size_t filenamePos = disposition.find("filename=\"");
-            if (filenamePos != std::string::npos) {
-                filenamePos += 10; // length of "filename=\""
-                size_t endQuote = disposition.find("\"", filenamePos);
-                if (endQuote != std::string::npos) {
-                    filename = disposition.substr(filenamePos, endQuote - filenamePos);
-                }
+    std::string uploadPath = serverConfig.root + "/uploads/";
+
+    // The body is parsed as it is read back, 64k at a time, and file parts are
+    // written out as their bytes go by: memory use does not grow with the upload
+    MultipartParser parser(boundary);
+    const RequestBody& body = request.getBody();
+    std::string window; // Unparsed bytes: one read plus whatever the parser held back
+    size_t windowStart = 0;
+    size_t bodyOffset = 0;
+    char chunk[65536];
+    AtomicFile file; // Appears under its name only once the part is complete
+    bool storingPart = false;
+    std::string filePath;
+    int status = HTTP_OK;
+
+    while (status == HTTP_OK) {
+        size_t consumed = 0;
+        const char* data = window.data() + windowStart;
+        MultipartParser::Event event = parser.parse(data, window.size() - windowStart, consumed);
+        windowStart += consumed;
+
+        if (event == MultipartParser::EVENT_NEED_MORE) {
+            ssize_t bytesRead = body.read(bodyOffset, chunk, sizeof(chunk));
+            if (bytesRead <= 0) {
+                Utils::logError("Multipart body ended before its closing boundary");
+                status = (bytesRead < 0) ? HTTP_INTERNAL_SERVER_ERROR : HTTP_BAD_REQUEST;
+                break;
             }
-            
-            // Extract field name
-            size_t namePos = disposition.find("name=\"");
-            if (namePos != std::string::npos) {
-                namePos += 6; // length of "name=\""
-                size_t endQuote = disposition.find("\"", namePos);
-                if (endQuote != std::string::npos) {
-                    name = disposition.substr(namePos, endQuote - namePos);
-                }
+            bodyOffset += static_cast<size_t>(bytesRead);
+            window.erase(0, windowStart);
+            windowStart = 0;
+            window.append(chunk, static_cast<size_t>(bytesRead));
+        } else if (event == MultipartParser::EVENT_PART_BEGIN) {
+            // Only file parts are stored; plain form fields are skipped
+            if (parser.filename().empty()) {
+                continue;
             }
-        }
-        
-        // If it's a file upload
-        if (!filename.empty()) {
-            std::string uploadPath = serverConfig.root + "/uploads/";
-            
             // Create uploads directory if it doesn't exist
-            if (!Utils::isDirectory(uploadPath)) {
-                if (mkdir(uploadPath.c_str(), 0755) != 0) {
-                    Utils::logError("Failed to create upload directory: " + uploadPath);
-                    return HttpResponse::createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
-                }
+            if (!Utils::isDirectory(uploadPath) && mkdir(uploadPath.c_str(), 0755) != 0) {
+                Utils::logError("Failed to create upload directory: " + uploadPath);
+                status = HTTP_INTERNAL_SERVER_ERROR;
+                break;
             }
-            
-            if (saveUploadedFile(filename, content, uploadPath)) {
-                Utils::logInfo("File uploaded successfully: " + filename);
-            } else {
-                Utils::logError("Failed to save uploaded file: " + filename);
-                return HttpResponse::createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
+            filePath = uniqueUploadPath(parser.filename(), uploadPath);
+            storingPart = file.open(filePath);
+            if (!storingPart) {
+                status = HTTP_INTERNAL_SERVER_ERROR;
+            }
+        } else if (event == MultipartParser::EVENT_PART_DATA) {
+            if (storingPart && !file.write(data, consumed)) {
+                Utils::logError("Failed to save uploaded file: " + filePath + ": " + strerror(errno));
+                status = HTTP_INTERNAL_SERVER_ERROR;
             }
+        } else if (event == MultipartParser::EVENT_PART_END) {
+            if (storingPart) {
+                storingPart = false;
+                if (!file.commit()) {
+                    status = HTTP_INTERNAL_SERVER_ERROR;
+                } else {
+                    invalidateCachedPath(filePath); // May hold a cached 404 for it
+                    Utils::logInfo("File uploaded successfully: " + Utils::getBasename(filePath));
+                }
+            }
+        } else if (event == MultipartParser::EVENT_DONE) {
+            break;
+        } else {
+            Utils::logError("Malformed multipart/form-data body");
+            status = HTTP_BAD_REQUEST;
         }
     }
+
+    // A part cut short is discarded along with `file`
+    if (status != HTTP_OK) {
+        return HttpResponse::createErrorResponse(status);
+    }
     
     // Return success response
     HttpResponse response;
@@ -924,13 +1447,7 @@ HttpResponse Server::handleFileUpload(const HttpRequest& request, const ServerCo
 HttpResponse Server::handleSimpleFileUpload(const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& location) {
     // Check location-specific body size limit
     // size_t bodySize = request.getBody().length();
-	size_t bodySize = 0;
-    if (!request.getBodyFilePath().empty()) {
-        struct stat st;
-        if (stat(request.getBodyFilePath().c_str(), &st) == 0) {
-            bodySize = st.st_size;
-        }
-    }
+	size_t bodySize = request.getBody().size();
     size_t maxBodySize = location.maxBodySize > 0 ? location.maxBodySize : serverConfig.maxBodySize;
     
     if (bodySize > maxBodySize) {
@@ -990,12 +1507,14 @@ HttpResponse Server::handleSimpleFileUpload(const HttpRequest& request, const Se
         // Simple timestamp-based filename
         time_t now = time(0);
         char timeStr[32];
-        strftime(timeStr, sizeof(timeStr), "%Y%m%d_%H%M%S", localtime(&now));
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        strftime(timeStr, sizeof(timeStr), "%Y%m%d_%H%M%S", &timeinfo);
         filename = std::string("upload_") + timeStr + extension;
     }
     
     // Save the file
-	if (saveUploadedFile(filename, request.getBodyFilePath(), uploadPath, true)) {
+	if (saveUploadedFile(filename, request.getBody(), uploadPath)) {
         Utils::logInfo("File uploaded successfully via simple POST: " + filename);
         
         HttpResponse response(201);
@@ -1009,7 +1528,7 @@ HttpResponse Server::handleSimpleFileUpload(const HttpRequest& request, const Se
 	return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
 }
 
-bool Server::saveUploadedFile(const std::string& filename, const std::string& content, const std::string& uploadPath) {
+std::string Server::uniqueUploadPath(const std::string& filename, const std::string& uploadPath) {
     // Sanitize filename - remove path traversal attempts
     std::string sanitizedFilename = Utils::getBasename(filename);
     std::string fullPath = uploadPath + sanitizedFilename;
@@ -1028,53 +1547,17 @@ bool Server::saveUploadedFile(const std::string& filename, const std::string& co
         }
         counter++;
     }
-    
-    return Utils::writeFile(finalPath, content);
+    return finalPath;
 }
 
-bool Server::saveUploadedFile(const std::string& filename, const std::string& srcFilePath, const std::string& uploadPath, bool isTempFile) {
-    // Sanitize filename
-    std::string sanitizedFilename = Utils::getBasename(filename);
-    std::string fullPath = uploadPath + sanitizedFilename;
-    
-    // Check if file already exists
-    std::string finalPath = fullPath;
-    int counter = 1;
-    while (Utils::fileExists(finalPath)) {
-        size_t dotPos = sanitizedFilename.find_last_of('.');
-        if (dotPos != std::string::npos) {
-            std::string baseName = sanitizedFilename.substr(0, dotPos);
-            std::string extension = sanitizedFilename.substr(dotPos);
-            finalPath = uploadPath + baseName + "_" + Utils::intToString(counter) + extension;
-        } else {
-            finalPath = uploadPath + sanitizedFilename + "_" + Utils::intToString(counter);
-        }
-        counter++;
-    }
+bool Server::saveUploadedFile(const std::string& filename, const RequestBody& body, const std::string& uploadPath) {
+    std::string finalPath = uniqueUploadPath(filename, uploadPath);
 
-    if (isTempFile) {
-        // Try to rename (move) the temp file, which is very fast
-        if (std::rename(srcFilePath.c_str(), finalPath.c_str()) == 0) {
-            return true;
-        }
-        // If rename fails (e.g., different devices), fall back to copy
-    }
-    
-    // Fallback to copy
-    std::ifstream srcFile(srcFilePath.c_str(), std::ios::binary);
-    if (!srcFile.is_open()) {
-        Utils::logError("saveUploadedFile: Failed to open source file: " + srcFilePath);
-        return false;
-    }
-    std::ofstream destFile(finalPath.c_str(), std::ios::binary);
-    if (!destFile.is_open()) {
-        Utils::logError("saveUploadedFile: Failed to open destination file: " + finalPath);
-        srcFile.close();
+    // A spooled body is linked into place when it can be; otherwise it is written out
+    if (!body.saveTo(finalPath)) {
         return false;
     }
-    destFile << srcFile.rdbuf();
-    srcFile.close();
-    destFile.close();
+    invalidateCachedPath(finalPath); // May hold a cached 404 for it
     return true;
 }
 
@@ -1149,18 +1632,14 @@ HttpResponse Server::handleRedirection(const LocationConfig& location) {
     return response;
 }
 
-ServerConfig Server::getServerConfig(int clientFd) const {
-    // Find which server socket this client came from
-    std::map<int, int>::const_iterator it = _clientServerSockets.find(clientFd);
-    if (it != _clientServerSockets.end()) {
-        int serverSocket = it->second;
-        std::map<int, ServerConfig>::const_iterator configIt = _serverConfigs.find(serverSocket);
-        if (configIt != _serverConfigs.end()) {
-            return configIt->second;
-        }
+const ServerConfig& Server::getServerConfig(int clientFd) const {
+    // Resolved once at accept time from the listener the client came in on
+    std::map<int, Client>::const_iterator it = _clients.find(clientFd);
+    if (it != _clients.end() && it->second.getServerConfig()) {
+        return *it->second.getServerConfig();
     }
     // Fallback to default server if mapping not found
-    return _config.getDefaultServer();
+    return _defaultServerConfig;
 }
 
 int Server::getPort() const {
@@ -1179,8 +1658,6 @@ bool Server::isRunning() const {
 HttpResponse Server::handleJSONPost(const HttpRequest& request, const ServerConfig& serverConfig) {
     std::string uri = request.getUri();
 
-	std::string body = Utils::readFile(request.getBodyFilePath());
-
     // Generate a filename based on current timestamp if posting to a directory
     std::string filePath;
     if (uri.empty() || uri[uri.length() - 1] == '/') {
@@ -1201,10 +1678,11 @@ HttpResponse Server::handleJSONPost(const HttpRequest& request, const ServerConf
         return createErrorResponse(HTTP_FORBIDDEN, serverConfig);
     }
     
-    // Write the JSON content to the file
-    if (!Utils::writeFile(filePath, body)) {
+    // Write the JSON content to the file, replacing any previous version in one step
+    if (!request.getBody().saveTo(filePath)) {
         return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
     }
+    invalidateCachedPath(filePath);
     
     Utils::logInfo("JSON file created via POST: " + filePath);
     
@@ -1213,6 +1691,7 @@ HttpResponse Server::handleJSONPost(const HttpRequest& request, const ServerConf
     response.setContentType("application/json");
     response.setHeader("Location", uri);
     response.setBody("{\"message\":\"JSON file created successfully\",\"location\":\"" + uri + "\"}");
+    response.setCompressible(true);
     
     return response;
 }
@@ -1260,7 +1739,7 @@ HttpResponse Server::createErrorResponse(int statusCode, const ServerConfig& ser
     return HttpResponse::createErrorResponse(statusCode);
 }
 
-bool Server::startAsyncCGI(int clientFd, const std::string& scriptPath, const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& locationConfig, const std::string& bodyFilePath) {
+bool Server::startAsyncCGI(int clientFd, const std::string& scriptPath, const HttpRequest& request, const ServerConfig& serverConfig, const LocationConfig& locationConfig) {
     // For regex locations with CGI, we don't require the physical file to exist
     if (!Utils::fileExists(scriptPath) && !locationConfig.isRegex) {
         HttpResponse response = createErrorResponse(HTTP_NOT_FOUND, serverConfig);
@@ -1286,10 +1765,53 @@ bool Server::startAsyncCGI(int clientFd, const std::string& scriptPath, const Ht
         return false;
     }
     
+    // Build the environment and argv before forking: with worker threads the
+    // child may only call async-signal-safe functions until execve().
+    CGI cgi;
+    cgi.setScriptPath(scriptPath);
+    cgi.setInterpreter(interpreter);
+    // The body itself goes to the CGI's stdin; only its size is needed here
+    cgi.setBodyLength(request.getBody().size());
+    // A spooled body is the CGI's stdin as it is; only an in-memory one is fed through a pipe
+    bool hasBody = request.getMethod() == "POST" && request.getBody().isOpen();
+    int bodyFd = hasBody ? request.getBody().spoolFd() : -1;
+    if (bodyFd >= 0 && lseek(bodyFd, 0, SEEK_SET) != 0) {
+        bodyFd = -1; // Not seekable after all; the pipe works for any body
+    }
+    cgi.setupEnvironment(request, serverConfig.serverName, serverConfig.port);
+    std::map<int, Client>::iterator clientIt = _clients.find(clientFd);
+    if (clientIt != _clients.end()) {
+        cgi.setEnvironmentVariable("REMOTE_ADDR", clientIt->second.getPeerAddress());
+    }
+    
+    char** envArray = cgi.createEnvArray();
+    if (!envArray) {
+        Utils::logError("Failed to create environment array for CGI");
+        HttpResponse response = createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
+        queueResponse(clientFd, response);
+        return false;
+    }
+    
+    std::string scriptDir = Utils::getDirectory(scriptPath);
+    // Custom CGI executables (like ubuntu_cgi_tester) and php-cgi get the full path,
+    // interpreters get the script name relative to the script directory
+    std::string scriptArg = (!locationConfig.cgiPath.empty() || extension == ".php") ? scriptPath : Utils::getBasename(scriptPath);
+    char* args[] = { const_cast<char*>(interpreter.c_str()), const_cast<char*>(scriptArg.c_str()), NULL };
+    
     // Create pipes for communication
-    int pipeFdIn[2], pipeFdOut[2];
-    if (pipe(pipeFdIn) == -1 || pipe(pipeFdOut) == -1) {
+    int pipeFdIn[2] = { -1, -1 };
+    int pipeFdOut[2];
+    if (bodyFd < 0 && !createCloexecPipe(pipeFdIn)) {
+        Utils::logError("Failed to create pipes for CGI: " + std::string(strerror(errno)));
+        cgi.freeEnvArray(envArray);
+        HttpResponse response = createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
+        queueResponse(clientFd, response);
+        return false;
+    }
+    if (!createCloexecPipe(pipeFdOut)) {
         Utils::logError("Failed to create pipes for CGI: " + std::string(strerror(errno)));
+        closePipe(pipeFdIn);
+        cgi.freeEnvArray(envArray);
         HttpResponse response = createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
         queueResponse(clientFd, response);
         return false;
@@ -1298,123 +1820,76 @@ bool Server::startAsyncCGI(int clientFd, const std::string& scriptPath, const Ht
     pid_t pid = fork();
     if (pid == -1) {
         Utils::logError("Failed to fork for CGI: " + std::string(strerror(errno)));
-        close(pipeFdIn[0]); close(pipeFdIn[1]);
+        closePipe(pipeFdIn);
         close(pipeFdOut[0]); close(pipeFdOut[1]);
+        cgi.freeEnvArray(envArray);
         HttpResponse response = createErrorResponse(HTTP_INTERNAL_SERVER_ERROR, serverConfig);
         queueResponse(clientFd, response);
         return false;
     }
     
     if (pid == 0) {
-        // Child process - execute CGI (same as original executeCGI)
-        close(pipeFdIn[1]);  // Close write end of input pipe
-        close(pipeFdOut[0]); // Close read end of output pipe
-        
-        dup2(pipeFdIn[0], STDIN_FILENO);
+        // Child process - wire up the pipes and exec (dup2 clears close-on-exec)
+        dup2(bodyFd >= 0 ? bodyFd : pipeFdIn[0], STDIN_FILENO);
         dup2(pipeFdOut[1], STDOUT_FILENO);
         // Don't redirect stderr - let it go to the parent's stderr
         
-        close(pipeFdIn[0]);
-        close(pipeFdOut[1]);
-        
-        CGI cgi;
-        cgi.setScriptPath(scriptPath);
-        cgi.setInterpreter(interpreter);
-        
-		if (!bodyFilePath.empty()) {
-            // This is now the ONLY way the child gets a body
-            cgi.setBodyFromFile(bodyFilePath);
-        } else {
-            cgi.setBody(""); // No file, no body
+        if (!scriptDir.empty() && chdir(scriptDir.c_str()) != 0) {
+            _exit(1);
         }
-		
-        cgi.setupEnvironment(request, serverConfig.serverName, serverConfig.port);
         
-        char** envArray = cgi.createEnvArray();
-        if (!envArray) {
-            Utils::logError("Failed to create environment array for CGI");
-            exit(1);
-        }
+        execve(interpreter.c_str(), args, envArray);
         
-        std::string scriptDir = Utils::getDirectory(scriptPath);
-        std::string scriptName = Utils::getBasename(scriptPath);
-        if (!scriptDir.empty()) {
-            chdir(scriptDir.c_str());
-        }
-        
-        // Execute based on whether we have a custom CGI path or standard interpreter
-        if (!locationConfig.cgiPath.empty()) {
-            // Custom CGI executable (like ubuntu_cgi_tester)
-            char* args[] = { const_cast<char*>(interpreter.c_str()), const_cast<char*>(scriptPath.c_str()), NULL };
-            execve(interpreter.c_str(), args, envArray);
-        } else if (extension == ".php") {
-            char* args[] = { const_cast<char*>(interpreter.c_str()), const_cast<char*>(scriptPath.c_str()), NULL };
-            execve(interpreter.c_str(), args, envArray);
-        } else {
-            char* args[] = { const_cast<char*>(interpreter.c_str()), const_cast<char*>(scriptName.c_str()), NULL };
-            execve(interpreter.c_str(), args, envArray);
-        }
-        
-        cgi.freeEnvArray(envArray);
-        Utils::logError("exec failed: " + std::string(strerror(errno)));
-        exit(1);
+        static const char message[] = "ERROR: CGI exec failed\n";
+        ssize_t ignored = write(STDERR_FILENO, message, sizeof(message) - 1);
+        (void)ignored;
+        _exit(1);
     } else {
         // Parent process - set up async monitoring
-        close(pipeFdIn[0]);  // Close read end of input pipe
+        cgi.freeEnvArray(envArray);
         close(pipeFdOut[1]); // Close write end of output pipe
         
         // Make output pipe non-blocking
         int flags = fcntl(pipeFdOut[0], F_GETFL, 0);
         fcntl(pipeFdOut[0], F_SETFL, flags | O_NONBLOCK);
-
-		int cgiInputFd = pipeFdIn[1];
-        flags = fcntl(cgiInputFd, F_GETFL, 0);
-        fcntl(cgiInputFd, F_SETFL, flags | O_NONBLOCK);
         
-        // Add CGI output pipe to poll monitoring (this part is the same)
-        struct pollfd cgiPollFd;
-        cgiPollFd.fd = pipeFdOut[0];
-        cgiPollFd.events = POLLIN;
-        cgiPollFd.revents = 0;
-        _pollFds.push_back(cgiPollFd);
+        // Add CGI output pipe to event loop monitoring
+        _eventLoop.add(pipeFdOut[0], EventLoop::HANDLER_CGI_OUTPUT, EventLoop::EVENT_READ);
         
         // Store CGI process information
         CgiProcess cgiProc;
         cgiProc.pid = pid;
         cgiProc.outputFd = pipeFdOut[0];
         cgiProc.clientFd = clientFd;
-        cgiProc.startTime = time(NULL);
+        cgiProc.timer = _timers.create(TimerWheel::TIMER_CGI, pipeFdOut[0]);
+        _timers.arm(cgiProc.timer, _now + static_cast<uint64_t>(serverConfig.cgiTimeout) * 1000);
         cgiProc.serverConfig = serverConfig;
+        cgiProc.locationConfig = locationConfig;
+        cgiProc.compressAllowed = locationConfig.gzip && negotiateCompression(request, cgiProc.compressFormat);
         
-        // Store new input pipe info
-        cgiProc.inputFd = cgiInputFd;
-
-		cgiProc.bodyFilePath = bodyFilePath;
-
-		if (request.getMethod() == "POST" && !cgiProc.bodyFilePath.empty()) {
-            cgiProc.bodyFile = new std::ifstream(cgiProc.bodyFilePath.c_str(), std::ios::binary);
-                if (cgiProc.bodyFile->is_open()) { // Use ->
-                // Add CGI *input* pipe to poll monitoring
-                struct pollfd cgiWritePollFd;
-                cgiWritePollFd.fd = cgiInputFd;
-                cgiWritePollFd.events = POLLOUT;
-                cgiWritePollFd.revents = 0;
-                _pollFds.push_back(cgiWritePollFd);
+        if (bodyFd >= 0) {
+            // The child reads the spool itself; nothing to write from here
+            _cgiProcesses[pipeFdOut[0]] = cgiProc;
+        } else {
+            close(pipeFdIn[0]);  // Close read end of input pipe
+            int cgiInputFd = pipeFdIn[1];
+            flags = fcntl(cgiInputFd, F_GETFL, 0);
+            fcntl(cgiInputFd, F_SETFL, flags | O_NONBLOCK);
+            cgiProc.inputFd = cgiInputFd;
+
+            if (hasBody) {
+                // Holds a reference, so the body outlives the client's request
+                cgiProc.body = request.getBody();
+                // Add CGI *input* pipe to event loop monitoring
+                _eventLoop.add(cgiInputFd, EventLoop::HANDLER_CGI_INPUT, EventLoop::EVENT_WRITE);
                 
-                _cgiProcesses[pipeFdOut[0]] = cgiProc; // This copy is fine now
+                _cgiProcesses[pipeFdOut[0]] = cgiProc;
                 _cgiWritePipes[cgiInputFd] = pipeFdOut[0];
-
             } else {
-                Utils::logError("Failed to open body file: " + cgiProc.bodyFilePath);
-                delete cgiProc.bodyFile; // Clean up memory
-                cgiProc.bodyFile = NULL;
+                // No body to write, just close the input pipe
                 close(cgiInputFd);
                 _cgiProcesses[pipeFdOut[0]] = cgiProc;
             }
-        } else {
-            // No body to write, just close the input pipe
-            close(cgiInputFd);
-            _cgiProcesses[pipeFdOut[0]] = cgiProc;
         }
 
         Utils::logInfo("Started async CGI process for client " + Utils::intToString(clientFd) +
@@ -1440,7 +1915,12 @@ void Server::handleCgiCompletion(int cgiOutputFd) {
     
     // Read all available data - poll() indicated this fd is ready
     while ((bytesRead = read(cgiOutputFd, buffer, sizeof(buffer))) > 0) {
-        cgiProc.output.append(buffer, bytesRead);
+        if (!appendCgiOutput(cgiProc, buffer, bytesRead)) {
+            // Part of the body is already lost, so it can't go out as a compressed stream
+            Utils::logError("Failed to compress CGI output for client " + Utils::intToString(cgiProc.clientFd));
+            failCgiProcess(cgiOutputFd, HTTP_BAD_GATEWAY);
+            return;
+        }
         
         // For very large files, occasionally yield control to prevent blocking
         if (cgiProc.output.length() % (10 * 1024 * 1024) == 0) { // Every 10MB
@@ -1460,49 +1940,36 @@ void Server::handleCgiCompletion(int cgiOutputFd) {
         Utils::logInfo("CGI output complete for client " + Utils::intToString(cgiProc.clientFd) + 
                       ", total size: " + Utils::sizeToString(cgiProc.output.length()) + " bytes");
         
+        if (cgiProc.compressor && !cgiProc.compressor->finish(cgiProc.output)) {
+            Utils::logError("Failed to finish compressing CGI output for client " + Utils::intToString(cgiProc.clientFd));
+            failCgiProcess(cgiOutputFd, HTTP_BAD_GATEWAY);
+            return;
+        }
+        
         // Wait for CGI process to finish
         int status;
         waitpid(cgiProc.pid, &status, WNOHANG);
         
         // Parse CGI output and send response
         HttpResponse response;
-        size_t headerEnd = cgiProc.output.find("\r\n\r\n");
+        size_t headerEnd = cgiProc.headerEnd;
         if (headerEnd == std::string::npos) {
-            headerEnd = cgiProc.output.find("\n\n");
-            if (headerEnd != std::string::npos) {
-                headerEnd += 2;
-            }
-        } else {
-            headerEnd += 4;
+            headerEnd = findCgiHeaderEnd(cgiProc.output, cgiProc.headerScanned);
         }
         
         if (headerEnd != std::string::npos) {
-            std::string headers = cgiProc.output.substr(0, headerEnd);
-            std::string body = cgiProc.output.substr(headerEnd);
+            parseCgiHeaders(cgiProc.output.substr(0, headerEnd), response);
             
-            // Parse headers
-            std::vector<std::string> headerLines = Utils::split(headers, '\n');
-            for (size_t i = 0; i < headerLines.size(); ++i) {
-                std::string line = Utils::trim(headerLines[i]);
-                if (line.empty()) continue;
-                
-                size_t colonPos = line.find(':');
-                if (colonPos != std::string::npos) {
-                    std::string name = Utils::trim(line.substr(0, colonPos));
-                    std::string value = Utils::trim(line.substr(colonPos + 1));
-                    
-                    if (name == "Status") {
-                        int statusCode = Utils::stringToInt(value.substr(0, 3));
-                        response.setStatus(statusCode);
-                    } else if (name == "Content-Type") {
-                        response.setContentType(value);
-                    } else {
-                        response.setHeader(name, value);
-                    }
-                }
-            }
+            // The body is moved into the response, never copied
+            cgiProc.output.erase(0, headerEnd);
+            response.adoptBody(cgiProc.output);
             
-            response.setBody(body);
+            if (cgiProc.compressor) {
+                response.setHeader("Content-Encoding", Compressor::encodingName(cgiProc.compressFormat));
+            }
+            if (compressionApplies(cgiProc.locationConfig, response.getHeader("Content-Type"))) {
+                response.setHeader("Vary", "Accept-Encoding");
+            }
         } else {
             // No proper headers, treat as plain text
             response.setStatus(HTTP_OK);
@@ -1518,6 +1985,92 @@ void Server::handleCgiCompletion(int cgiOutputFd) {
     }
 }
 
+// Collects CGI output. Once the header block is in and the location, content type
+// and body length call for it, the body is compressed from then on as it arrives,
+// so only the compressed form is buffered. Returns false if compression fails.
+bool Server::appendCgiOutput(CgiProcess& cgiProc, const char* data, size_t length) {
+    if (cgiProc.compressor) {
+        return cgiProc.compressor->update(data, length, cgiProc.output);
+    }
+    cgiProc.output.append(data, length);
+    if (cgiProc.compressDecided) {
+        return true;
+    }
+    if (!cgiProc.compressAllowed) {
+        cgiProc.compressDecided = true;
+        return true;
+    }
+    
+    if (cgiProc.headerEnd == std::string::npos) {
+        cgiProc.headerEnd = findCgiHeaderEnd(cgiProc.output, cgiProc.headerScanned);
+        if (cgiProc.headerEnd == std::string::npos) {
+            cgiProc.headerScanned = cgiProc.output.length();
+            return true;
+        }
+        
+        // The header block is judged once, when it completes; from then on only
+        // the body length is waited for
+        HttpResponse headers;
+        parseCgiHeaders(cgiProc.output.substr(0, cgiProc.headerEnd), headers);
+        if (!headers.getHeader("Content-Encoding").empty() ||
+            !compressionApplies(cgiProc.locationConfig, headers.getHeader("Content-Type"))) {
+            cgiProc.compressDecided = true;
+            return true;
+        }
+    }
+    
+    if (cgiProc.output.length() - cgiProc.headerEnd < cgiProc.locationConfig.gzipMinLength) {
+        return true; // Decide once more of the body is in (or at EOF, leaving it uncompressed)
+    }
+    
+    cgiProc.compressDecided = true;
+    Compressor* compressor = new Compressor();
+    if (!compressor->begin(cgiProc.compressFormat, cgiProc.locationConfig.gzipCompLevel)) {
+        delete compressor;
+        return true; // Nothing compressed yet, so the body goes out as is
+    }
+    std::string body = cgiProc.output.substr(cgiProc.headerEnd);
+    cgiProc.output.erase(cgiProc.headerEnd);
+    cgiProc.compressor = compressor;
+    return compressor->update(body.data(), body.length(), cgiProc.output);
+}
+
+// Finds the blank line ending the CGI header block, searching only from `scanned`
+// bytes in (less 3, for a terminator split across reads), since the output before
+// that was already searched.
+size_t Server::findCgiHeaderEnd(const std::string& output, size_t scanned) {
+    size_t from = (scanned > 3) ? scanned - 3 : 0;
+    size_t crlf = output.find("\r\n\r\n", from);
+    size_t lf = output.find("\n\n", from);
+    if (crlf != std::string::npos && (lf == std::string::npos || crlf < lf)) {
+        return crlf + 4;
+    }
+    return (lf != std::string::npos) ? lf + 2 : std::string::npos;
+}
+
+void Server::parseCgiHeaders(const std::string& headers, HttpResponse& response) {
+    std::vector<std::string> headerLines = Utils::split(headers, '\n');
+    for (size_t i = 0; i < headerLines.size(); ++i) {
+        std::string line = Utils::trim(headerLines[i]);
+        if (line.empty()) continue;
+        
+        size_t colonPos = line.find(':');
+        if (colonPos != std::string::npos) {
+            std::string name = Utils::trim(line.substr(0, colonPos));
+            std::string value = Utils::trim(line.substr(colonPos + 1));
+            
+            if (name == "Status") {
+                int statusCode = Utils::stringToInt(value.substr(0, 3));
+                response.setStatus(statusCode);
+            } else if (name == "Content-Type") {
+                response.setContentType(value);
+            } else {
+                response.setHeader(name, value);
+            }
+        }
+    }
+}
+
 void Server::cleanupCgiProcess(int cgiOutputFd) {
     std::map<int, CgiProcess>::iterator it = _cgiProcesses.find(cgiOutputFd);
     if (it == _cgiProcesses.end()) {
@@ -1528,38 +2081,17 @@ void Server::cleanupCgiProcess(int cgiOutputFd) {
     // referencing freed memory (Valgrind flagged an invalid read here).
     CgiProcess cgiProcCopy = it->second; // make a copy
     int clientFd = cgiProcCopy.clientFd;
-    std::string bodyFilePathCopy = cgiProcCopy.bodyFilePath;
 
-    // Remove output pipe from poll monitoring
-    for (std::vector<struct pollfd>::iterator pollIt = _pollFds.begin(); pollIt != _pollFds.end(); ++pollIt) {
-        if (pollIt->fd == cgiOutputFd) {
-            _pollFds.erase(pollIt);
-            break;
-        }
-    }
+    _timers.release(cgiProcCopy.timer);
+
+    // Remove output pipe from event loop monitoring
+    _eventLoop.remove(cgiOutputFd);
 
     // Close output pipe
     close(cgiOutputFd);
 
-    // Close and delete any open body file held by the copy's resources were
-    // already duplicated; the original object's bodyFile pointer must be
-    // cleaned up from the map element itself before erasing to avoid leaks.
-    if (cgiProcCopy.bodyFile != NULL) {
-        // The copy's bodyFile points to the same object as the original; if
-        // the original still owned it, we need to close & delete on the
-        // original element to avoid double-delete. To be safe, attempt to
-        // close/delete via the iterator target if present.
-        if (it->second.bodyFile != NULL) {
-            it->second.bodyFile->close();
-            delete it->second.bodyFile;
-            it->second.bodyFile = NULL;
-        }
-    }
-
-    // Clean up temp file (use the copied path)
-    if (!bodyFilePathCopy.empty()) {
-        cleanupTempFile(bodyFilePathCopy);
-    }
+    delete it->second.compressor;
+    it->second.compressor = NULL;
 
     // Also remove any write-pipe entries that reference this CGI process
     // (they store the output fd). Collect keys to remove first to avoid
@@ -1573,17 +2105,10 @@ void Server::cleanupCgiProcess(int cgiOutputFd) {
     for (size_t i = 0; i < writePipesToRemove.size(); ++i) {
         int inputFd = writePipesToRemove[i];
 
-        // Close input fd
+        // Remove from event loop, then close input fd
+        _eventLoop.remove(inputFd);
         close(inputFd);
 
-        // Remove from pollfd list
-        for (std::vector<struct pollfd>::iterator pollIt = _pollFds.begin(); pollIt != _pollFds.end(); ++pollIt) {
-            if (pollIt->fd == inputFd) {
-                _pollFds.erase(pollIt);
-                break;
-            }
-        }
-
         // Erase from write-pipe map
         _cgiWritePipes.erase(inputFd);
     }
@@ -1607,9 +2132,7 @@ void Server::queueCgiRequest(int clientFd, const std::string& scriptPath,
     queuedRequest.scriptPath = scriptPath;
     queuedRequest.serverConfig = serverConfig;
     queuedRequest.locationConfig = locationConfig;
-	queuedRequest.request = request;
-
-	queuedRequest.bodyFilePath = request.getBodyFilePath();
+	queuedRequest.request = request; // Shares the body, which stays alive while queued
 
     _cgiQueue.push_back(queuedRequest);
     Utils::logInfo("Queued CGI request for client " + Utils::intToString(clientFd) + " (queue size: " + Utils::intToString(_cgiQueue.size()) + ")");
@@ -1624,7 +2147,7 @@ void Server::processCgiQueue() {
         
         if (startAsyncCGI(queuedRequest.clientFd, queuedRequest.scriptPath, 
                          queuedRequest.request, queuedRequest.serverConfig, 
-                         queuedRequest.locationConfig, queuedRequest.bodyFilePath)) {
+                         queuedRequest.locationConfig)) {
             // Successfully started - remove from queue
             _cgiQueue.erase(_cgiQueue.begin());
         } else {
@@ -1635,58 +2158,6 @@ void Server::processCgiQueue() {
     }
 }
 
-// Temporary file utilities for large body handling
-std::string Server::createTempFile() {
-    static int counter = 0;
-    std::ostringstream oss;
-    oss << "/tmp/webserv_body_" << getpid() << "_" << time(NULL) << "_" << (++counter);
-    return oss.str();
-}
-
-bool Server::writeBodyToFile(const std::string& body, const std::string& filePath) {
-    std::ofstream file(filePath.c_str(), std::ios::binary);
-    if (!file) {
-        Utils::logError("Failed to create temporary file: " + filePath);
-        return false;
-    }
-    
-    file.write(body.c_str(), body.length());
-    if (!file) {
-        Utils::logError("Failed to write body to temporary file: " + filePath);
-        file.close();
-        unlink(filePath.c_str()); // Cleanup on failure
-        return false;
-    }
-    
-    file.close();
-    Utils::logInfo("Written " + Utils::sizeToString(body.length()) + " bytes to temp file: " + filePath);
-    return true;
-}
-
-std::string Server::readBodyFromFile(const std::string& filePath) {
-    std::ifstream file(filePath.c_str(), std::ios::binary);
-    if (!file) {
-        Utils::logError("Failed to open temporary file: " + filePath);
-        return "";
-    }
-    
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-    
-    std::string body = buffer.str();
-    Utils::logInfo("Read " + Utils::sizeToString(body.length()) + " bytes from temp file: " + filePath);
-    return body;
-}
-
-void Server::cleanupTempFile(const std::string& filePath) {
-    if (unlink(filePath.c_str()) == 0) {
-        Utils::logInfo("Cleaned up temporary file: " + filePath);
-    } else {
-        Utils::logError("Failed to cleanup temporary file: " + filePath);
-    }
-}
-
 void Server::handleCgiWrite(int cgiInputFd) {
     // Look up the output fd associated with this input fd
     std::map<int, int>::iterator wpIt = _cgiWritePipes.find(cgiInputFd);
@@ -1695,29 +2166,28 @@ void Server::handleCgiWrite(int cgiInputFd) {
     int cgiOutputFd = wpIt->second;
     std::map<int, CgiProcess>::iterator procIt = _cgiProcesses.find(cgiOutputFd);
     if (procIt == _cgiProcesses.end()) {
-        // No corresponding CGI process found (might have been cleaned up). Clean up mapping and pollfd.
+        // No corresponding CGI process found (might have been cleaned up). Clean up mapping and registration.
+        _eventLoop.remove(cgiInputFd);
         close(cgiInputFd);
-        for (std::vector<struct pollfd>::iterator pollIt = _pollFds.begin(); pollIt != _pollFds.end(); ++pollIt) {
-            if (pollIt->fd == cgiInputFd) {
-                _pollFds.erase(pollIt);
-                break;
-            }
-        }
         _cgiWritePipes.erase(wpIt);
         return;
     }
 
     CgiProcess& cgiProc = procIt->second;
 
-    if (!cgiProc.bodyFile || !cgiProc.bodyFile->is_open()) {
+    if (!cgiProc.body.isOpen()) {
         // Should not happen, but safeguard: cleanup the CGI process
         cleanupCgiProcess(cgiProc.outputFd);
         return;
     }
 
     char readBuffer[65536];
-    cgiProc.bodyFile->read(readBuffer, sizeof(readBuffer));
-    ssize_t bytesRead = cgiProc.bodyFile->gcount();
+    ssize_t bytesRead = cgiProc.body.read(cgiProc.bodyOffset, readBuffer, sizeof(readBuffer));
+    if (bytesRead < 0) {
+        Utils::logError("CGI body read failed");
+        cleanupCgiProcess(cgiProc.outputFd);
+        return;
+    }
 
     if (bytesRead > 0) {
         ssize_t written = write(cgiInputFd, readBuffer, bytesRead);
@@ -1728,99 +2198,122 @@ void Server::handleCgiWrite(int cgiInputFd) {
             cleanupCgiProcess(cgiProc.outputFd);
             return;
         }
-
-        if (written < bytesRead) {
-            // Partially wrote. Rewind file to re-read the unwritten part.
-            cgiProc.bodyFile->seekg(written - bytesRead, std::ios::cur);
-            return; // Wait for next POLLOUT
-        }
+        // Only what the pipe took counts; the rest is read again on the next POLLOUT
+        cgiProc.bodyOffset += static_cast<size_t>(written);
     }
 
-    // If we read 0 bytes, or we're at EOF, we are done writing.
-    if (bytesRead == 0 || cgiProc.bodyFile->eof()) {
-        // Done writing. Close file, pipe, and remove from poll.
-        cgiProc.bodyFile->close();
-        delete cgiProc.bodyFile;
-        cgiProc.bodyFile = NULL;
-
-        close(cgiInputFd);
-        // Erase mapping for this input fd
-        _cgiWritePipes.erase(wpIt);
+    // Done once the whole body went through
+    if (cgiProc.bodyOffset >= cgiProc.body.size()) {
+        closeCgiInput(cgiInputFd);
+    }
+}
 
-        // Remove from _pollFds
-        for (std::vector<struct pollfd>::iterator pollIt = _pollFds.begin(); pollIt != _pollFds.end(); ++pollIt) {
-            if (pollIt->fd == cgiInputFd) {
-                _pollFds.erase(pollIt);
-                break;
-            }
+void Server::closeCgiInput(int cgiInputFd) {
+    std::map<int, int>::iterator wpIt = _cgiWritePipes.find(cgiInputFd);
+    if (wpIt != _cgiWritePipes.end()) {
+        std::map<int, CgiProcess>::iterator procIt = _cgiProcesses.find(wpIt->second);
+        if (procIt != _cgiProcesses.end()) {
+            procIt->second.body.reset();
         }
+        _cgiWritePipes.erase(wpIt);
     }
+
+    // Done writing. Remove from the event loop and close the pipe so the CGI sees EOF.
+    _eventLoop.remove(cgiInputFd);
+    close(cgiInputFd);
 }
 
-void Server::checkClientTimeouts() {
-    time_t currentTime = time(NULL);
+void Server::refreshClientTimer(Client& client) {
+    const ServerConfig& config = client.getServerConfig() ? *client.getServerConfig() : _defaultServerConfig;
     
-    // Iterate safely, as removeClient will modify _clients
-    std::map<int, Client>::iterator it = _clients.begin();
-    while (it != _clients.end()) {
-        int clientFd = it->first;
-        Client& client = it->second;
-        
-        // Get the specific config for this client's server
-        ServerConfig config = getServerConfig(clientFd);
-        int timeout = config.keepAliveTimeout; 
-        
-        if (difftime(currentTime, client.getLastActivity()) > timeout) {
-            Utils::logInfo("Client " + Utils::intToString(clientFd) + 
-                          " timed out (idle for " + Utils::intToString(timeout) + 
-                          "s). Disconnecting.");
-            
-            // Get iterator to next element *before* erasing
-            std::map<int, Client>::iterator toRemove = it;
-            ++it;
-            removeClient(toRemove->first); // Just remove it.
-        } else {
-            ++it; // No timeout, check next client
+    if (client.getState() == Client::STATE_READING_HEADERS && !client.getBuffer().empty()) {
+        // A request has started: its headers must be complete within client_header_timeout,
+        // no matter how slowly they trickle in
+        if (!client.isHeaderTimerArmed()) {
+            _timers.arm(client.getTimer(), _now + static_cast<uint64_t>(config.clientHeaderTimeout) * 1000);
+            client.setHeaderTimerArmed(true);
         }
+        return;
     }
+    client.setHeaderTimerArmed(false);
+    _timers.arm(client.getTimer(), _now + static_cast<uint64_t>(config.keepAliveTimeout) * 1000);
 }
 
-void Server::checkCgiTimeouts() {
-    time_t currentTime = time(NULL);
+void Server::processTimers() {
+    _expiredTimers.clear();
+    _timers.expire(_now, _expiredTimers);
     
-    std::map<int, CgiProcess>::iterator it = _cgiProcesses.begin();
-    while (it != _cgiProcesses.end()) {
-        // int cgiOutputFd = it->first; // This line is removed
-        CgiProcess& cgiProc = it->second;
+    for (size_t i = 0; i < _expiredTimers.size(); ++i) {
+        const TimerWheel::Expired& timer = _expiredTimers[i];
         
-        int cgiTimeout = cgiProc.serverConfig.cgiTimeout;
+        // An earlier handler in this batch may have released or re-armed it
+        if (_timers.isArmed(timer.id)) {
+            continue;
+        }
         
-        if (difftime(currentTime, cgiProc.startTime) > cgiTimeout) {
-            Utils::logError("CGI process (pid " + Utils::intToString(cgiProc.pid) + 
-                           ") for client " + Utils::intToString(cgiProc.clientFd) + 
-                           " timed out (" + Utils::intToString(cgiTimeout) + "s). Killing.");
-                           
-            // 1. Kill the hanging CGI process
-            kill(cgiProc.pid, SIGKILL);
-            waitpid(cgiProc.pid, NULL, 0); // Reap the zombie
-            
-            // 2. Send 504 Gateway Timeout to the client
-            HttpResponse response = createErrorResponse(504, cgiProc.serverConfig);
-            response.setHeader("Connection", "close");
-            queueResponse(cgiProc.clientFd, response);
-
-            // 3. Mark client for close (if it still exists)
-            if (_clients.count(cgiProc.clientFd)) {
-                _clients[cgiProc.clientFd].markForCloseAfterWrite();
+        switch (timer.kind) {
+            case TimerWheel::TIMER_CLIENT: {
+                std::map<int, Client>::iterator it = _clients.find(timer.key);
+                if (it != _clients.end() && it->second.getTimer() == timer.id) {
+                    handleClientTimeout(timer.key);
+                }
+                break;
             }
-            
-            // 4. Clean up CGI resources (this erases `it` from _cgiProcesses)
-            // We must get the next iterator *before* calling this.
-            std::map<int, CgiProcess>::iterator toRemove = it;
-            ++it;
-            cleanupCgiProcess(toRemove->first); // Uses the key from the iterator directly
-        } else {
-            ++it; // No timeout, advance iterator
+            case TimerWheel::TIMER_CGI: {
+                std::map<int, CgiProcess>::iterator it = _cgiProcesses.find(timer.key);
+                if (it != _cgiProcesses.end() && it->second.timer == timer.id) {
+                    handleCgiTimeout(timer.key);
+                }
+                break;
+            }
+            case TimerWheel::TIMER_LISTENER:
+                // Back off is over; accepting resumes on the next wakeup
+                _eventLoop.modify(timer.key, EventLoop::EVENT_READ);
+                break;
         }
     }
 }
+
+void Server::handleClientTimeout(int clientFd) {
+    const ServerConfig& config = getServerConfig(clientFd);
+    int timeout = _clients[clientFd].isHeaderTimerArmed() ? config.clientHeaderTimeout : config.keepAliveTimeout;
+    
+    Utils::logInfo("Client " + Utils::intToString(clientFd) + 
+                  " timed out (idle for " + Utils::intToString(timeout) + 
+                  "s). Disconnecting.");
+    removeClient(clientFd);
+}
+
+void Server::handleCgiTimeout(int cgiOutputFd) {
+    CgiProcess& cgiProc = _cgiProcesses[cgiOutputFd];
+    int cgiTimeout = cgiProc.serverConfig.cgiTimeout;
+    
+    Utils::logError("CGI process (pid " + Utils::intToString(cgiProc.pid) + 
+                   ") for client " + Utils::intToString(cgiProc.clientFd) + 
+                   " timed out (" + Utils::intToString(cgiTimeout) + "s). Killing.");
+                   
+    failCgiProcess(cgiOutputFd, HTTP_GATEWAY_TIMEOUT);
+}
+
+// Kills a CGI whose output can't be delivered and answers its client with
+// `statusCode` instead, closing the connection afterwards
+void Server::failCgiProcess(int cgiOutputFd, int statusCode) {
+    CgiProcess& cgiProc = _cgiProcesses[cgiOutputFd];
+    
+    // 1. Kill the CGI process
+    kill(cgiProc.pid, SIGKILL);
+    waitpid(cgiProc.pid, NULL, 0); // Reap the zombie
+    
+    // 2. Send the error to the client
+    HttpResponse response = createErrorResponse(statusCode, cgiProc.serverConfig);
+    response.setHeader("Connection", "close");
+    queueResponse(cgiProc.clientFd, response);
+
+    // 3. Mark client for close (if it still exists)
+    if (_clients.count(cgiProc.clientFd)) {
+        _clients[cgiProc.clientFd].markForCloseAfterWrite();
+    }
+    
+    // 4. Clean up CGI resources
+    cleanupCgiProcess(cgiOutputFd);
+}
@@ -0,0 +1,58 @@
+#include "../include/SharedBuffer.hpp"
+
+SharedBuffer::SharedBuffer() : _shared(NULL) {
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer& other) : _shared(other._shared) {
+    if (_shared) {
+        ++_shared->refs;
+    }
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other) {
+    if (_shared != other._shared) {
+        release();
+        _shared = other._shared;
+        if (_shared) {
+            ++_shared->refs;
+        }
+    }
+    return *this;
+}
+
+SharedBuffer::~SharedBuffer() {
+    release();
+}
+
+void SharedBuffer::adopt(std::string& data) {
+    release();
+    if (data.empty()) {
+        return;
+    }
+    _shared = new Shared;
+    _shared->data.swap(data);
+    _shared->refs = 1;
+}
+
+void SharedBuffer::reset() {
+    release();
+}
+
+bool SharedBuffer::empty() const {
+    return _shared == NULL;
+}
+
+const char* SharedBuffer::data() const {
+    return _shared ? _shared->data.data() : "";
+}
+
+size_t SharedBuffer::size() const {
+    return _shared ? _shared->data.size() : 0;
+}
+
+void SharedBuffer::release() {
+    if (_shared && --_shared->refs == 0) {
+        delete _shared;
+    }
+    _shared = NULL;
+}
@@ -0,0 +1,228 @@
+#include "../include/Supervisor.hpp"
+#include "../include/Server.hpp"
+#include "../include/Utils.hpp"
+
+Supervisor::Supervisor(const Config& config) : _config(config), _server(NULL), _stopRequested(0), _isWorker(false) {
+}
+
+Supervisor::~Supervisor() {
+    delete _server;
+}
+
+bool Supervisor::initialize() {
+    _server = new Server(_config);
+    if (!_server->openListeners()) {
+        return false;
+    }
+    _workers.assign(_config.getGlobalConfig().workerProcesses, Worker());
+    return true;
+}
+
+void Supervisor::run() {
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        spawnWorker(i);
+    }
+    
+    while (!_stopRequested) {
+        // Interrupted early by SIGINT/SIGTERM/SIGCHLD, none of them SA_RESTART
+        sleep(1);
+        
+        reapWorkers();
+        checkWorkerMemory();
+        
+        // Refill empty slots whose respawn delay has passed
+        uint64_t now = TimerWheel::monotonicNow();
+        for (size_t i = 0; i < _workers.size() && !_stopRequested; ++i) {
+            if (_workers[i].pid <= 0 && now >= _workers[i].respawnAt) {
+                spawnWorker(i);
+            }
+        }
+    }
+    
+    stopWorkers();
+}
+
+void Supervisor::requestStop() {
+    if (_isWorker) {
+        if (_server) {
+            _server->requestStop();
+        }
+        return;
+    }
+    _stopRequested = 1;
+}
+
+void Supervisor::spawnWorker(size_t slot) {
+    Worker& worker = _workers[slot];
+    worker.startedAt = TimerWheel::monotonicNow();
+    pid_t pid = fork();
+    if (pid < 0) {
+        Utils::logError("Failed to fork worker " + Utils::sizeToString(slot) + ": " + std::string(strerror(errno)));
+        worker.pid = -1;
+        scheduleRespawn(slot);
+        return;
+    }
+    
+    if (pid == 0) {
+        // Worker: the listeners were inherited, only the event loop is per-process.
+        // CGI children are reaped with waitpid(), so SIGCHLD goes back to its default.
+        _isWorker = true;
+        signal(SIGCHLD, SIG_DFL);
+        if (!_server->setupEventLoop()) {
+            std::exit(1);
+        }
+        _server->run();
+        delete _server;
+        _server = NULL;
+        std::exit(0);
+    }
+    
+    worker.pid = pid;
+    Utils::logInfo("Started worker " + Utils::sizeToString(slot) + " (pid " + Utils::intToString(pid) + ")");
+}
+
+void Supervisor::reapWorkers() {
+    int status;
+    pid_t pid;
+    
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        std::vector<pid_t>::iterator retired = std::find(_retiring.begin(), _retiring.end(), pid);
+        if (retired != _retiring.end()) {
+            _retiring.erase(retired);
+            Utils::logInfo("Recycled worker (pid " + Utils::intToString(pid) + ") has finished draining");
+            continue;
+        }
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            if (_workers[i].pid == pid) {
+                workerExited(i, status);
+                break;
+            }
+        }
+    }
+}
+
+void Supervisor::workerExited(size_t slot, int status) {
+    Worker& worker = _workers[slot];
+    std::string name = "Worker " + Utils::sizeToString(slot) + " (pid " + Utils::intToString(worker.pid) + ")";
+    if (WIFSIGNALED(status)) {
+        Utils::logError(name + " killed by signal " + Utils::intToString(WTERMSIG(status)));
+    } else {
+        Utils::logInfo(name + " exited with status " + Utils::intToString(WEXITSTATUS(status)));
+    }
+    worker.pid = -1;
+    if (!_stopRequested) {
+        scheduleRespawn(slot);
+    }
+}
+
+// A worker that ran for a while is replaced at once. One that died right after
+// starting (bad config, missing CGI interpreter, out of memory) is restarted after
+// 1s, then 2s, 4s, ... up to a minute, so a crash loop does not spin on fork().
+void Supervisor::scheduleRespawn(size_t slot) {
+    Worker& worker = _workers[slot];
+    uint64_t now = TimerWheel::monotonicNow();
+    if (now - worker.startedAt >= MIN_UPTIME_MS) {
+        worker.quickExits = 0;
+        worker.respawnAt = now;
+        return;
+    }
+    
+    uint64_t delay = RESPAWN_DELAY_MS;
+    for (int i = 0; i < worker.quickExits && delay < MAX_RESPAWN_DELAY_MS; ++i) {
+        delay *= 2;
+    }
+    delay = std::min(delay, static_cast<uint64_t>(MAX_RESPAWN_DELAY_MS));
+    ++worker.quickExits;
+    worker.respawnAt = now + delay;
+    Utils::logError("Worker " + Utils::sizeToString(slot) + " failed " + Utils::intToString(worker.quickExits) +
+                   " time(s) right after starting, restarting it in " + Utils::sizeToString(delay / 1000) + "s");
+}
+
+void Supervisor::checkWorkerMemory() {
+    size_t limit = _config.getGlobalConfig().workerMemoryLimit;
+    if (limit == 0) {
+        return;
+    }
+    
+    // A fresh worker is left alone for a while, so a limit set below what a worker
+    // needs at startup recycles every few seconds instead of in a fork loop
+    uint64_t now = TimerWheel::monotonicNow();
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        Worker& worker = _workers[i];
+        if (worker.pid <= 0 || now - worker.startedAt < MIN_UPTIME_MS) {
+            continue;
+        }
+        size_t rss = getResidentSize(worker.pid);
+        if (rss > limit) {
+            Utils::logError("Worker " + Utils::sizeToString(i) + " (pid " + Utils::intToString(worker.pid) +
+                           ") uses " + Utils::sizeToString(rss) + " bytes, over worker_memory_limit. Recycling.");
+            // The slot is refilled straight away; the old worker stops accepting and
+            // finishes its open requests in the background (Server::beginDrain)
+            kill(worker.pid, SIGTERM);
+            _retiring.push_back(worker.pid);
+            worker.pid = -1;
+            worker.quickExits = 0;
+            worker.respawnAt = 0;
+        }
+    }
+}
+
+void Supervisor::stopWorkers() {
+    // The master's copies of the listeners go first, so that connections are
+    // refused rather than queued once the workers have closed theirs
+    _server->closeListeners();
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i].pid > 0) {
+            kill(_workers[i].pid, SIGTERM);
+        }
+    }
+    for (size_t i = 0; i < _retiring.size(); ++i) {
+        kill(_retiring[i], SIGTERM);
+    }
+    
+    // Workers finish their in-flight requests within shutdown_timeout; any still
+    // running a little after that are forced down
+    uint64_t deadline = TimerWheel::monotonicNow() + STOP_GRACE_MS +
+                        static_cast<uint64_t>(_config.getGlobalConfig().shutdownTimeout) * 1000;
+    reapWorkers();
+    while (hasLiveWorkers() && TimerWheel::monotonicNow() < deadline) {
+        usleep(100000);
+        reapWorkers();
+    }
+    
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i].pid > 0) {
+            _retiring.push_back(_workers[i].pid);
+            _workers[i].pid = -1;
+        }
+    }
+    for (size_t i = 0; i < _retiring.size(); ++i) {
+        Utils::logError("Worker (pid " + Utils::intToString(_retiring[i]) + ") did not stop, killing it");
+        kill(_retiring[i], SIGKILL);
+        waitpid(_retiring[i], NULL, 0);
+    }
+    _retiring.clear();
+}
+
+bool Supervisor::hasLiveWorkers() const {
+    if (!_retiring.empty()) {
+        return true;
+    }
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i].pid > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Supervisor::getResidentSize(pid_t pid) const {
+    std::string statm = Utils::readFile("/proc/" + Utils::intToString(pid) + "/statm");
+    std::istringstream iss(statm);
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (!(iss >> totalPages >> residentPages)) {
+        return 0;
+    }
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
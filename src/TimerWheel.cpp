@@ -0,0 +1,185 @@
+#include "../include/TimerWheel.hpp"
+
+const TimerWheel::TimerId TimerWheel::INVALID_TIMER = static_cast<TimerWheel::TimerId>(-1);
+
+TimerWheel::TimerWheel() : _currentTick(0), _armedCount(0) {
+    for (size_t i = 0; i < LEVEL0_SIZE + LEVEL1_SIZE; ++i) {
+        _slots[i] = INVALID_TIMER;
+    }
+    reset(monotonicNow());
+}
+
+uint64_t TimerWheel::monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+void TimerWheel::reset(uint64_t now) {
+    for (size_t i = 0; i < _nodes.size(); ++i) {
+        if (_nodes[i].slot >= 0) {
+            unlink(i);
+        }
+    }
+    _currentTick = now / TICK_MS;
+}
+
+TimerWheel::TimerId TimerWheel::create(TimerKind kind, int key) {
+    TimerId id;
+    if (!_freeNodes.empty()) {
+        id = _freeNodes.back();
+        _freeNodes.pop_back();
+    } else {
+        id = _nodes.size();
+        _nodes.push_back(Node());
+    }
+    Node& node = _nodes[id];
+    node.deadline = 0;
+    node.kind = kind;
+    node.key = key;
+    node.prev = INVALID_TIMER;
+    node.next = INVALID_TIMER;
+    node.slot = -1;
+    node.inUse = true;
+    return id;
+}
+
+void TimerWheel::release(TimerId id) {
+    if (id >= _nodes.size() || !_nodes[id].inUse) {
+        return;
+    }
+    cancel(id);
+    _nodes[id].inUse = false;
+    _freeNodes.push_back(id);
+}
+
+void TimerWheel::arm(TimerId id, uint64_t deadline) {
+    if (id >= _nodes.size() || !_nodes[id].inUse) {
+        return;
+    }
+    cancel(id);
+    _nodes[id].deadline = deadline;
+    link(id);
+}
+
+void TimerWheel::cancel(TimerId id) {
+    if (id < _nodes.size() && _nodes[id].slot >= 0) {
+        unlink(id);
+    }
+}
+
+bool TimerWheel::isArmed(TimerId id) const {
+    return id < _nodes.size() && _nodes[id].slot >= 0;
+}
+
+void TimerWheel::link(TimerId id) {
+    Node& node = _nodes[id];
+
+    // Round up so a timer never fires early
+    uint64_t tick = (node.deadline + TICK_MS - 1) / TICK_MS;
+    if (tick < _currentTick) {
+        tick = _currentTick;
+    }
+    uint64_t delta = tick - _currentTick;
+
+    int slot;
+    if (delta < LEVEL0_SIZE) {
+        slot = static_cast<int>(tick & (LEVEL0_SIZE - 1));
+    } else {
+        if (delta >= static_cast<uint64_t>(LEVEL0_SIZE) * LEVEL1_SIZE) {
+            // Beyond the wheel's range: re-linked with its real deadline on cascade
+            tick = _currentTick + static_cast<uint64_t>(LEVEL0_SIZE) * LEVEL1_SIZE - 1;
+        }
+        slot = LEVEL0_SIZE + static_cast<int>((tick >> LEVEL0_BITS) & (LEVEL1_SIZE - 1));
+    }
+
+    node.slot = slot;
+    node.prev = INVALID_TIMER;
+    node.next = _slots[slot];
+    if (node.next != INVALID_TIMER) {
+        _nodes[node.next].prev = id;
+    }
+    _slots[slot] = id;
+    ++_armedCount;
+}
+
+void TimerWheel::unlink(TimerId id) {
+    Node& node = _nodes[id];
+    if (node.prev != INVALID_TIMER) {
+        _nodes[node.prev].next = node.next;
+    } else {
+        _slots[node.slot] = node.next;
+    }
+    if (node.next != INVALID_TIMER) {
+        _nodes[node.next].prev = node.prev;
+    }
+    node.prev = INVALID_TIMER;
+    node.next = INVALID_TIMER;
+    node.slot = -1;
+    --_armedCount;
+}
+
+void TimerWheel::cascade(int slot) {
+    TimerId id = _slots[slot];
+    _slots[slot] = INVALID_TIMER;
+    while (id != INVALID_TIMER) {
+        TimerId next = _nodes[id].next;
+        _nodes[id].slot = -1;
+        --_armedCount;
+        link(id);
+        id = next;
+    }
+}
+
+void TimerWheel::expire(uint64_t now, std::vector<Expired>& expired) {
+    uint64_t nowTick = now / TICK_MS;
+    if (_armedCount == 0) {
+        // Nothing to walk; just catch up
+        if (_currentTick <= nowTick) {
+            _currentTick = nowTick + 1;
+        }
+        return;
+    }
+
+    while (_currentTick <= nowTick) {
+        if ((_currentTick & (LEVEL0_SIZE - 1)) == 0) {
+            cascade(LEVEL0_SIZE + static_cast<int>((_currentTick >> LEVEL0_BITS) & (LEVEL1_SIZE - 1)));
+        }
+
+        int slot = static_cast<int>(_currentTick & (LEVEL0_SIZE - 1));
+        while (_slots[slot] != INVALID_TIMER) {
+            TimerId id = _slots[slot];
+            unlink(id);
+            Expired entry;
+            entry.id = id;
+            entry.kind = _nodes[id].kind;
+            entry.key = _nodes[id].key;
+            expired.push_back(entry);
+        }
+        ++_currentTick;
+    }
+}
+
+int TimerWheel::nextTimeout(uint64_t now) const {
+    if (_armedCount == 0) {
+        return -1;
+    }
+
+    // The next non-empty fine slot, or the next cascade point, whichever is first
+    uint64_t tick = _currentTick;
+    for (size_t i = 0; i < LEVEL0_SIZE; ++i, ++tick) {
+        if (i > 0 && (tick & (LEVEL0_SIZE - 1)) == 0) {
+            break;
+        }
+        if (_slots[tick & (LEVEL0_SIZE - 1)] != INVALID_TIMER) {
+            break;
+        }
+    }
+
+    uint64_t when = tick * TICK_MS;
+    if (when <= now) {
+        return 0;
+    }
+    uint64_t wait = when - now;
+    return (wait > static_cast<uint64_t>(INT_MAX)) ? INT_MAX : static_cast<int>(wait);
+}
@@ -1,4 +1,5 @@
 #include "../include/Utils.hpp"
+#include "../include/Clock.hpp"
 
 namespace Utils {
     // String utilities
@@ -91,6 +92,21 @@ namespace Utils {
         return file.good();
     }
 
+    bool writeAll(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = write(fd, data, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
     std::string getDirectory(const std::string& path) {
         size_t slashPos = path.find_last_of('/');
         if (slashPos == std::string::npos) {
@@ -177,18 +193,41 @@ namespace Utils {
         return "application/octet-stream";
     }
 
-    std::string getCurrentTime() {
-        time_t now = time(0);
-        struct tm* timeinfo = gmtime(&now);
+    // Log lines are written from outside the event loop too (startup, the
+    // supervisor), so they refresh the date themselves
+    const std::string& getCurrentTime() {
+        Clock::update();
+        return Clock::httpDate();
+    }
+
+    std::string formatHttpDate(time_t time) {
+        struct tm timeinfo;
+        gmtime_r(&time, &timeinfo);
         char buffer[80];
-        strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+        strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
         return std::string(buffer);
     }
 
+    bool parseHttpDate(const std::string& date, time_t& time) {
+        // IMF-fixdate first, then the obsolete RFC 850 and asctime forms
+        static const char* formats[] = {"%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %d %H:%M:%S %Y"};
+        for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+            struct tm timeinfo;
+            memset(&timeinfo, 0, sizeof(timeinfo));
+            const char* end = strptime(date.c_str(), formats[i], &timeinfo);
+            if (end && *end == '\0') {
+                time = timegm(&timeinfo);
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::string formatTime(time_t time) {
-        struct tm* timeinfo = gmtime(&time);
+        struct tm timeinfo;
+        gmtime_r(&time, &timeinfo);
         char buffer[80];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
         return std::string(buffer);
     }
     
@@ -198,7 +237,10 @@ namespace Utils {
         socklen_t addrLen = sizeof(addr);
         
         if (getpeername(socket, (struct sockaddr*)&addr, &addrLen) == 0) {
-            return std::string(inet_ntoa(addr.sin_addr));
+            char buffer[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, &addr.sin_addr, buffer, sizeof(buffer))) {
+                return std::string(buffer);
+            }
         }
         
         return "unknown";
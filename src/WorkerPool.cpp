@@ -0,0 +1,80 @@
+#include "../include/WorkerPool.hpp"
+#include "../include/Server.hpp"
+#include "../include/Utils.hpp"
+
+WorkerPool::WorkerPool(const Config& config) : _config(config) {
+}
+
+WorkerPool::~WorkerPool() {
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        delete _workers[i];
+    }
+    _workers.clear();
+}
+
+bool WorkerPool::initialize() {
+    int count = _config.getGlobalConfig().workerThreads;
+    
+    // Bind every worker's listeners up front so configuration errors surface before any thread starts
+    for (int i = 0; i < count; ++i) {
+        Server* server = new Server(_config);
+        _workers.push_back(server);
+        if (!server->initialize()) {
+            Utils::logError("Failed to initialize worker " + Utils::intToString(i));
+            return false;
+        }
+    }
+    
+    if (count > 1) {
+        Utils::logInfo("Started " + Utils::intToString(count) + " worker event loops");
+    }
+    return true;
+}
+
+void WorkerPool::run() {
+    if (_workers.empty()) {
+        return;
+    }
+    
+    // Signals are handled by the main thread only; extra workers inherit a blocked mask
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    
+    for (size_t i = 1; i < _workers.size(); ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerMain, _workers[i]) != 0) {
+            Utils::logError("Failed to start worker thread " + Utils::sizeToString(i));
+            continue;
+        }
+        _threads.push_back(thread);
+    }
+    
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    
+    // The main thread runs the first worker itself
+    _workers[0]->run();
+    
+    requestStop();
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        pthread_join(_threads[i], NULL);
+    }
+    _threads.clear();
+}
+
+void WorkerPool::requestStop() {
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        _workers[i]->requestStop();
+    }
+}
+
+size_t WorkerPool::size() const {
+    return _workers.size();
+}
+
+void* WorkerPool::workerMain(void* arg) {
+    static_cast<Server*>(arg)->run();
+    return NULL;
+}
@@ -1,20 +1,40 @@
 #include "../include/webserv.hpp"
 #include "../include/Server.hpp"
 #include "../include/Config.hpp"
+#include "../include/WorkerPool.hpp"
+#include "../include/Supervisor.hpp"
 
 // Global variables for signal handling
-static bool g_serverRunning = true;
-static Server* g_server = NULL;
+static WorkerPool* g_pool = NULL;
+static Supervisor* g_supervisor = NULL;
 
 void signalHandler(int signal) {
-    if (signal == SIGINT) {
-        std::cout << "\nShutting down server..." << std::endl;
-        g_serverRunning = false;
-        if (g_server) {
-            g_server->stop();
+    if (signal == SIGINT || signal == SIGTERM) {
+        if (g_pool) {
+            g_pool->requestStop();
         }
-		std::cout << "Server stopped." << std::endl;
+        if (g_supervisor) {
+            g_supervisor->requestStop();
+        }
+    }
+}
+
+static void installSignalHandlers(bool supervisor) {
+    // No SA_RESTART: the supervisor's sleep()/waitpid() must return on shutdown
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signalHandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    if (supervisor) {
+        // Only to cut the supervisor's sleep() short when a worker dies
+        sigaction(SIGCHLD, &sa, NULL);
     }
+    
+    // Ignore SIGPIPE so that writing to closed pipes doesn't kill the process;
+    // we handle write errors explicitly in the server code.
+    signal(SIGPIPE, SIG_IGN);
 }
 
 int main(int argc, char **argv) {
@@ -36,25 +56,47 @@ int main(int argc, char **argv) {
             return 1;
         }
         
-        // Create and initialize server
-        Server server(config);
-        g_server = &server;
+        ServerConfig defaultServer = config.getDefaultServer();
+        
+        if (config.getGlobalConfig().workerProcesses > 0) {
+            // Master/worker mode: listeners are opened once and inherited by forked workers
+            Supervisor supervisor(config);
+            g_supervisor = &supervisor;
+            
+            if (!supervisor.initialize()) {
+                std::cerr << "Error: Failed to initialize server" << std::endl;
+                g_supervisor = NULL;
+                return 1;
+            }
+            
+            std::cout << "Server listening on " << defaultServer.host << ":" << defaultServer.port << std::endl;
+            installSignalHandlers(true);
+            
+            supervisor.run();
+            g_supervisor = NULL;
+            std::cout << "Server stopped." << std::endl;
+            return 0;
+        }
+        
+        // Create and initialize the worker event loops
+        WorkerPool pool(config);
+        g_pool = &pool;
         
-        if (!server.initialize()) {
+        if (!pool.initialize()) {
             std::cerr << "Error: Failed to initialize server" << std::endl;
+            g_pool = NULL;
             return 1;
         }
         
-        std::cout << "Server listening on " << server.getHost() << ":" << server.getPort() << std::endl;
+        std::cout << "Server listening on " << defaultServer.host << ":" << defaultServer.port << std::endl;
         
-        // Handle SIGINT for graceful shutdown
-		signal(SIGINT, signalHandler);
-		// Ignore SIGPIPE so that writing to closed pipes doesn't kill the process;
-		// we handle write errors explicitly in the server code.
-		signal(SIGPIPE, SIG_IGN);
+        // Handle SIGINT/SIGTERM for graceful shutdown
+        installSignalHandlers(false);
         
         // Run the server
-        server.run();
+        pool.run();
+        g_pool = NULL;
+        std::cout << "Server stopped." << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;